@@ -15,7 +15,10 @@
 #include <vector>
 #include <regex>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
 #include <map>
+#include <array>
 
 using u8 = uint8_t;
 using u16 = uint16_t;
@@ -95,11 +98,86 @@ vector<str> split_string(str_cref line, char sep)
 
 
 
+// a Draw is a fixed array of this many counts, enough for dozens of colors
+constexpr u32 MAX_COLORS = 64;
+
+/**
+* Assigns a dense id to every color name seen while parsing, so that a Draw
+* can be a plain array indexed by color. Names are keyed by their 64-bit
+* FNV-1a hash in a small open addressing table: resolving a color costs one
+* hash and usually one probe, plus one name comparison to rule out hash
+* collisions. All of it happens at parse time, the queries only see ids.
+*/
+struct Color_Registry
+{
+    // power of two, at most half full
+    static constexpr u32 SLOTS = 2 * MAX_COLORS;
+
+    struct Slot
+    {
+        u64 hash {0};
+        u32 id {0};
+        bool used {false};
+    };
+
+    std::array<Slot, SLOTS> slots {};
+    vector<str> names;
+
+    Color_Registry()
+    {
+        // the classic colors always get ids 0, 1, 2
+        intern("red");
+        intern("green");
+        intern("blue");
+    }
+
+    static constexpr u64 hash(string_view name)
+    {
+        u64 h = 14695981039346656037ULL;
+        for (char ch : name)
+        {
+            h ^= static_cast<u8>(ch);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    u32 intern(string_view name)
+    {
+        auto h = hash(name);
+
+        for (u32 i = h & (SLOTS - 1);
+             ;
+             i = (i + 1) & (SLOTS - 1))
+        {
+            auto& slot = slots[i];
+
+            if (slot.used and slot.hash == h and names[slot.id] == name)
+                return slot.id;
+
+            if (not slot.used)
+            {
+                if (names.size() == MAX_COLORS)
+                    throw std::runtime_error(std::format("[ERROR] too many colors, cannot add <{}>", name));
+
+                slot = Slot {h, static_cast<u32>(names.size()), true};
+                names.emplace_back(name);
+
+                return slot.id;
+            }
+        }
+    }
+
+    u32 size() const
+    {
+        return static_cast<u32>(names.size());
+    }
+};
+
 struct Draw
 {
-    i32 red{0};
-    i32 green{0};
-    i32 blue{0};
+    // indexed by Color_Registry id
+    std::array<i32, MAX_COLORS> count {};
 };
 
 struct Game
@@ -130,7 +208,7 @@ i32 extract_game_id(str_cref input)
     return res;
 }
 
-void extract_draws(Game& game, str input)
+void extract_draws(Game& game, str input, Color_Registry& colors)
 {
     // input -> "3 blue, 4 red; 1 red, 2 green, 6 blue; 2 green"
     
@@ -160,24 +238,9 @@ void extract_draws(Game& game, str input)
                 throw std::runtime_error(std::format("[ERROR] expected 3 matches for input <{}>", input));
 
             auto count = match[1].str();
-            auto color = match[2].str();
+            auto color = string_view {match[2].first, match[2].second};
 
-            if (color == "red")
-            {
-                draw.red = std::stoi(count);
-            }
-            else if (color == "green")
-            {
-                draw.green = std::stoi(count);
-            }
-            else if (color == "blue")
-            {
-                draw.blue = std::stoi(count);
-            }
-            else
-            {
-                throw std::runtime_error(std::format("[ERROR] unknown color <{}>", color));
-            }
+            draw.count.at(colors.intern(color)) = std::stoi(count);
 
             token = match.suffix();
         }
@@ -189,27 +252,39 @@ void extract_draws(Game& game, str input)
 
 }
 
-i32 sum_possible_games(vector<Game>& games, 
-                       i32 max_red, i32 max_green, i32 max_blue)
+/**
+* highest count of every color over all the draws of a game
+*/
+Draw max_per_color(const Game& game)
+{
+    Draw res {};
+
+    for (const auto& draw : game.draws)
+    {
+        for (u32 c = 0; c < MAX_COLORS; ++c)
+        {
+            res.count[c] = std::max(res.count[c], draw.count[c]);
+        }
+    }
+
+    return res;
+}
+
+i32 sum_possible_games(const vector<Game>& games, const Draw& bag)
 {
     i32 acc = 0;
 
-    for (auto& game : games)
+    for (const auto& game : games)
     {
-        i32 tot_red = 0;
-        i32 tot_green = 0;
-        i32 tot_blue = 0;
-        
-        for (auto& draw : game.draws)
+        auto max_draw = max_per_color(game);
+
+        bool possible = true;
+        for (u32 c = 0; c < MAX_COLORS; ++c)
         {
-            tot_red   = std::max(tot_red, draw.red);
-            tot_green = std::max(tot_green,draw.green);
-            tot_blue = std::max(tot_blue, draw.blue);
+            possible &= (max_draw.count[c] <= bag.count[c]);
         }
 
-        if (tot_red <= max_red and
-            tot_green <= max_green and
-            tot_blue <= max_blue)
+        if (possible)
         {
             //cout << "valid game id " << game.id << endl;
             acc += game.id;
@@ -227,6 +302,7 @@ void part1()
     str line{};
 
     vector<Game> games{};
+    Color_Registry colors{};
 
     while (std::getline(ifs, line))
     {
@@ -237,38 +313,57 @@ void part1()
 
         Game game{};
         game.id = extract_game_id(parts[0]);
-        extract_draws(game, parts[1]);
+        extract_draws(game, parts[1], colors);
 
         games.push_back(std::move(game));
 
         int s = 0;
     }
 
-     int s = 0;
-     auto num_games = sum_possible_games(games, 12, 13, 14);
+    // any color not listed here is not in the bag at all
+    Draw bag{};
+    bag.count[colors.intern("red")] = 12;
+    bag.count[colors.intern("green")] = 13;
+    bag.count[colors.intern("blue")] = 14;
+
+    auto num_games = sum_possible_games(games, bag);
 
     i32 res = num_games;
     cout << "part 1 (" << file_path << ") " << res << endl;
 }
 
-i32 sum_possible_games_p2(vector<Game>& games)
+i64 checked_mul(i64 a, i64 b)
 {
-    i32 acc = 0;
+    // counts are never negative
+    if (b != 0 and a > std::numeric_limits<i64>::max() / b)
+        throw std::overflow_error(std::format("[ERROR] power {} * {} does not fit in 64 bits", a, b));
+
+    return a * b;
+}
 
-    for (auto& game : games)
+i64 checked_add(i64 a, i64 b)
+{
+    if (b > std::numeric_limits<i64>::max() - a)
+        throw std::overflow_error(std::format("[ERROR] sum of powers {} + {} does not fit in 64 bits", a, b));
+
+    return a + b;
+}
+
+i64 sum_possible_games_p2(const vector<Game>& games, u32 num_colors)
+{
+    i64 acc = 0;
+
+    for (const auto& game : games)
     {
-        i32 tot_red = 0;
-        i32 tot_green = 0;
-        i32 tot_blue = 0;
+        auto max_draw = max_per_color(game);
 
-        for (auto& draw : game.draws)
+        i64 power = 1;
+        for (u32 c = 0; c < num_colors; ++c)
         {
-            tot_red   = std::max(tot_red, draw.red);
-            tot_green = std::max(tot_green,draw.green);
-            tot_blue = std::max(tot_blue, draw.blue);
+            power = checked_mul(power, max_draw.count[c]);
         }
 
-        acc += tot_red * tot_green * tot_blue;
+        acc = checked_add(acc, power);
     }
 
     return acc;
@@ -282,6 +377,7 @@ void part2()
     str line{};
 
     vector<Game> games{};
+    Color_Registry colors{};
 
     while (std::getline(ifs, line))
     {
@@ -292,7 +388,7 @@ void part2()
 
         Game game{};
         game.id = extract_game_id(parts[0]);
-        extract_draws(game, parts[1]);
+        extract_draws(game, parts[1], colors);
 
         games.push_back(std::move(game));
 
@@ -300,9 +396,9 @@ void part2()
     }
 
     int s = 0;
-    auto num_games = sum_possible_games_p2(games);
+    auto num_games = sum_possible_games_p2(games, colors.size());
 
-    i32 res = num_games;
+    i64 res = num_games;
     cout << "part 2 (" << file_path << ") " << res << endl;
 }
 
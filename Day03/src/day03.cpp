@@ -16,6 +16,11 @@
 #include <regex>
 #include <iterator>
 #include <map>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <thread>
 
 using u8 = uint8_t;
 using u16 = uint16_t;
@@ -112,221 +117,520 @@ bool is_symbol(char ch)
 
 using Grid = vec<vec<char>>;
 
-bool is_in_bounds(Grid& grid, i32 r, i32 c)
+string_view as_view(const vec<char>& row)
 {
-    auto rows = static_cast<i32>(grid.size());
-    auto cols = static_cast<i32>(grid.at(0).size());
+    return string_view {row.data(), row.size()};
+}
 
-    bool res =
-        (r >= 0 and r < rows)
-        and
-        (c >= 0 and c < cols);
+/**
+* width of the grid, the buffers are sized from it so every row must match
+*/
+i32 grid_cols(const Grid& grid)
+{
+    auto cols = grid.at(0).size();
 
-    return res;
+    for (u64 r = 1;
+         r < grid.size();
+         ++r)
+    {
+        if (grid[r].size() != cols)
+            throw std::runtime_error(std::format("[ERROR] expected {} columns, row {} has {}",
+                                                 cols, r + 1, grid[r].size()));
+    }
+
+    return static_cast<i32>(cols);
+}
+
+/**
+* One bit per column of a row: bit (c + 1) is column c, so there is a zero
+* guard bit on both sides and a mask can be shifted by one column without
+* any bounds check.
+*/
+using Bits = vec<u64>;
+
+Bits make_bits(i32 cols)
+{
+    return Bits((cols + 2 + 63) / 64, 0);
 }
 
-bool is_digit_adjacent_to_symbol(Grid& grid, i32 r, i32 c)
+Bits symbol_mask(string_view row, i32 cols)
 {
-    bool res = false;
+    auto bits = make_bits(cols);
 
-    for (i32 rr = -1; rr <= 1; ++rr)
+    for (i32 c = 0;
+         c < static_cast<i32>(row.size());
+         ++c)
     {
-        for (i32 cc = -1; cc <= 1; ++cc)
+        if (is_symbol(row[c]))
         {
-            if (is_in_bounds(grid, r + rr, c + cc))
-            {
-                res |= is_symbol(grid.at(r +rr).at(c+cc));
-            }
+            u32 i = c + 1;
+            bits[i / 64] |= 1ULL << (i % 64);
         }
     }
-    
+
+    return bits;
+}
+
+/**
+* OR the three rows together, then grow every set bit by one column
+* to the left and to the right: a set bit means "touches a symbol"
+*/
+Bits dilate(const Bits& above, const Bits& curr, const Bits& below)
+{
+    auto words = curr.size();
+
+    Bits vert(words);
+    for (u64 i = 0; i < words; ++i)
+    {
+        vert[i] = above[i] | curr[i] | below[i];
+    }
+
+    Bits res(words);
+    for (u64 i = 0; i < words; ++i)
+    {
+        u64 w = vert[i];
+        u64 carry_in_left = (i > 0) ? (vert[i - 1] >> 63) : 0;
+        u64 carry_in_right = (i + 1 < words) ? (vert[i + 1] << 63) : 0;
+
+        res[i] = w | (w << 1) | carry_in_left | (w >> 1) | carry_in_right;
+    }
+
     return res;
 }
 
-void part1()
+/**
+* true if any column in [first, last] is set
+*/
+bool any_in_span(const Bits& bits, i32 first, i32 last)
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
+    u32 lo = first + 1;
+    u32 hi = last + 1;
 
-    auto grid = vec<vec<char>>{};
+    for (u32 w = lo / 64;
+         w <= hi / 64;
+         ++w)
+    {
+        u64 mask = ~0ULL;
+        if (w == lo / 64)
+            mask &= ~0ULL << (lo % 64);
+        if (w == hi / 64)
+            mask &= ~0ULL >> (63 - hi % 64);
+
+        if (bits[w] & mask)
+            return true;
+    }
 
-    for (str line;
-         std::getline(ifs, line);
-         )
+    return false;
+}
+
+/**
+* sum of the numbers in row that overlap the dilated symbol mask near
+*/
+u64 sum_part_numbers_in_row(string_view row, const Bits& near)
+{
+    u64 acc = 0;
+    auto cols = static_cast<i32>(row.size());
+
+    for (i32 c = 0;
+         c < cols;
+         ++c)
     {
-        auto row = vec<char>{};
+        if (not std::isdigit(row[c]))
+            continue;
 
-        for (char c : line)
+        i32 first = c;
+        u64 num = 0;
+
+        while (c < cols and
+               std::isdigit(row[c]))
         {
-            row.push_back(c);
+            num = num * 10 + (row[c] - '0');
+            ++c;
+        }
+
+        if (any_in_span(near, first, c - 1))
+        {
+            acc += num;
         }
-        grid.push_back(std::move(row));
     }
 
+    return acc;
+}
 
-    i32 acc = 0;
+u64 sum_part_numbers(const Grid& grid)
+{
     auto rows = static_cast<i32>(grid.size());
-    auto cols = static_cast<i32>(grid.at(0).size());
+    auto cols = grid_cols(grid);
+
+    // one empty row above and below the grid
+    vec<Bits> symbols;
+    symbols.reserve(rows + 2);
+
+    symbols.push_back(make_bits(cols));
+    for (const auto& row : grid)
+    {
+        symbols.push_back(symbol_mask(as_view(row), cols));
+    }
+    symbols.push_back(make_bits(cols));
+
+    u64 acc = 0;
 
     for (i32 r = 0;
          r < rows;
          ++r)
     {
-        // row: "467..114.."
-        for (i32 c = 0;
-             c < cols;
-             ++c)
-        {
-            auto& col = grid.at(r);
-            char ch = col.at(c);
+        auto near = dilate(symbols[r], symbols[r + 1], symbols[r + 2]);
+        acc += sum_part_numbers_in_row(as_view(grid[r]), near);
+    }
 
-            if (std::isdigit(ch))
-            {
-                str num;
-                while (c < cols and
-                       std::isdigit(col.at(c)))
-                {
-                    num.push_back(col.at(c));
-                    ++c;
-                }
+    return acc;
+}
 
-                bool adj = false;
-                // for each digit in number
-                for (i32 i = c - num.size();
-                     i < c;
-                     ++i)
-                {
-                    bool res = is_digit_adjacent_to_symbol(grid, r, i);
-                    adj |= res;
-                }
+bool is_gear(char ch)
+{
+    return ch == '*';
+}
 
-                if (adj)
-                {
-                    //cout << std::format("({},{}) {} OK", r+1,c+1,num) << endl;
-                    acc += std::stoi(num);
-                }
-                else
-                {
-                    //cout << std::format("({},{}) {} sad", r+1,c+1,num) << endl;
-                }
-            }
+/**
+* Every digit cell holds the id of the number it belongs to, 0 elsewhere.
+* Ids start at 1 and index values as values[id - 1].
+*/
+struct Number_Labels
+{
+    i32 rows {};
+    i32 cols {};
 
-        }
+    // (rows + 2) x (cols + 2), with a border of zeros all around
+    vec<u32> ids;
+    vec<u64> values;
+
+    const u32* row(i32 r) const
+    {
+        return ids.data() + static_cast<u64>(r + 1) * (cols + 2);
     }
+};
 
-    i32 res = acc;
-    cout << "part 1 (" << file_path << ") " << res << endl;
+/**
+* labels the numbers of one row, ids must point at the padded row
+*/
+void label_row(string_view row, u32* ids, vec<u64>& values)
+{
+    auto cols = static_cast<i32>(row.size());
+
+    for (i32 c = 0;
+         c < cols;
+         ++c)
+    {
+        if (not std::isdigit(row[c]))
+            continue;
+
+        u64 num = 0;
+        auto id = static_cast<u32>(values.size() + 1);
+
+        while (c < cols and
+               std::isdigit(row[c]))
+        {
+            num = num * 10 + (row[c] - '0');
+            ids[c + 1] = id;
+            ++c;
+        }
+
+        values.push_back(num);
+    }
 }
 
-bool is_gear(char ch)
+Number_Labels label_numbers(const Grid& grid)
 {
-    return ch == '*';
-}
+    Number_Labels labels;
+    labels.rows = static_cast<i32>(grid.size());
+    labels.cols = grid_cols(grid);
+    labels.ids.assign(static_cast<u64>(labels.rows + 2) * (labels.cols + 2), 0);
+
+    for (i32 r = 0;
+         r < labels.rows;
+         ++r)
+    {
+        auto* ids = labels.ids.data() + static_cast<u64>(r + 1) * (labels.cols + 2);
+        label_row(as_view(grid[r]), ids, labels.values);
+    }
 
+    return labels;
+}
 
-struct Num
+/**
+* padded label row plus the values its ids refer to
+*/
+struct Label_Row
 {
-    str num;
-    i32 row{};
-    i32 start_col{};
-    i32 end_col{};
+    const u32* ids;
+    const u64* values;
 };
 
-struct Num_Comp
+/**
+* above, curr and below are padded label rows, gear_c is the column of the
+* gear in curr. A number lies on a single row and covers consecutive cells,
+* so within one row a repeated id can only come from the previous cell.
+*/
+u64 calculate_gear_ratio(Label_Row above, Label_Row curr, Label_Row below, i32 gear_c)
 {
-    bool operator()(const Num& lhs, const Num& rhs) const
+    std::array<u64, 2> nums {};
+    u32 count = 0;
+
+    for (const auto& row : {above, curr, below})
     {
-        if (lhs.row == rhs.row)
+        u32 prev = 0;
+
+        for (i32 c = gear_c; c <= gear_c + 2; ++c)
         {
-            return lhs.start_col < rhs.start_col;
+            u32 id = row.ids[c];
+
+            if (id != 0 and id != prev)
+            {
+                if (count == 2)
+                    return 0;
+
+                nums[count++] = row.values[id - 1];
+            }
+
+            prev = id;
         }
-        else
+    }
+
+    return (count == 2) ? nums[0] * nums[1] : 0;
+}
+
+u64 sum_gear_ratios(const Grid& grid)
+{
+    auto labels = label_numbers(grid);
+
+    u64 acc = 0;
+
+    for (i32 r = 0;
+         r < labels.rows;
+         ++r)
+    {
+        const auto& row = grid[r];
+
+        for (i32 c = 0;
+             c < labels.cols;
+             ++c)
         {
-            return lhs.row < rhs.row;
+            if (is_gear(row[c]))
+            {
+                const auto* values = labels.values.data();
+
+                acc += calculate_gear_ratio({labels.row(r - 1), values},
+                                            {labels.row(r), values},
+                                            {labels.row(r + 1), values},
+                                            c);
+            }
         }
     }
-};
 
-void read_nums_in_row(Grid& grid, vec<Num>& nums, i32 r)
+    return acc;
+}
+
+/**
+* Streaming version of both parts: only the last three rows of the schematic
+* are kept, which is all that is needed to settle the numbers and the gears
+* of the middle one. A row is settled as soon as the row below it is pushed.
+*/
+struct Row_Window
 {
-    if (r < 0)
-        return;
-    if (r > grid.size())
-        return;
+    struct Row
+    {
+        str chars;
+        Bits symbols;
+        vec<u32> ids;       // padded, ids are local to the row
+        vec<u64> values;
+    };
 
-    auto& col = grid.at(r);
-    auto cols = col.size();
+    i32 cols {-1};
+    u64 pushed {0};
+    std::array<Row, 3> ring;
+    Row blank;
 
-    for (i32 c = 0;
-         c < cols;
-         ++c)
+    // rows outside [first_owned, last_owned] are only read as context
+    u64 first_owned {0};
+    u64 last_owned {std::numeric_limits<u64>::max()};
+
+    u64 part_numbers {0};
+    u64 gear_ratios {0};
+
+    void push(string_view line)
     {
-        auto ch = col.at(c);
+        if (cols < 0)
+        {
+            cols = static_cast<i32>(line.size());
 
-        if (std::isdigit(ch))
+            blank.chars.assign(cols, '.');
+            blank.symbols = make_bits(cols);
+            blank.ids.assign(cols + 2, 0);
+        }
+        else if (static_cast<i32>(line.size()) != cols)
         {
-            Num num;
-            num.row = r;
+            throw std::runtime_error(std::format("[ERROR] expected {} columns, row {} has {}",
+                                                 cols, pushed + 1, line.size()));
+        }
 
-            num.start_col = c;
+        auto& row = ring[pushed % 3];
+        row.chars = line;
+        row.symbols = symbol_mask(row.chars, cols);
+        row.ids.assign(cols + 2, 0);
+        row.values.clear();
+        label_row(row.chars, row.ids.data(), row.values);
 
-            while (c < cols and
-                   std::isdigit(col.at(c)))
-            {
-                num.num.push_back(col.at(c));
-                ++c;
-            }
+        ++pushed;
 
-            num.end_col = c - 1;
+        if (pushed >= 2)
+        {
+            settle(pushed - 2);
+        }
+    }
 
-            nums.push_back(std::move(num));
+    void finish()
+    {
+        if (pushed >= 1)
+        {
+            settle(pushed - 1);
         }
     }
 
-    int s = 0;
-}
+private:
 
-bool is_between(i32 num, i32 min, i32 max)
-{
-    return (num >= min) and (num <= max);
-}
+    const Row& at(u64 r) const
+    {
+        // rows outside the schematic are empty
+        if (r >= pushed)
+            return blank;
+
+        return ring[r % 3];
+    }
+
+    void settle(u64 r)
+    {
+        if (r < first_owned or r > last_owned)
+            return;
+
+        const auto& above = (r == 0) ? blank : at(r - 1);
+        const auto& curr = at(r);
+        const auto& below = at(r + 1);
+
+        auto near = dilate(above.symbols, curr.symbols, below.symbols);
+        part_numbers += sum_part_numbers_in_row(curr.chars, near);
 
-bool is_suitable(const Num& num, i32 gear_r, i32 gear_c)
+        for (i32 c = 0;
+             c < cols;
+             ++c)
+        {
+            if (is_gear(curr.chars[c]))
+            {
+                gear_ratios += calculate_gear_ratio({above.ids.data(), above.values.data()},
+                                                    {curr.ids.data(), curr.values.data()},
+                                                    {below.ids.data(), below.values.data()},
+                                                    c);
+            }
+        }
+    }
+};
+
+struct Band_Result
 {
-    return (num.row == gear_r) and
-        is_between(gear_c, num.start_col, num.end_col);
-}
+    u64 part_numbers {0};
+    u64 gear_ratios {0};
+};
 
-i32 calculate_gear_ratio(Grid& grid, const vec<Num>& nums, i32 gear_r, i32 gear_c)
+/**
+* Both parts with the grid split in horizontal bands, one thread per band.
+* A band also pushes one halo row above and below into its window but only
+* settles its own rows, so every number and gear is counted exactly once.
+*/
+Band_Result solve_in_bands(const Grid& grid, u32 num_bands)
 {
-    set<Num, Num_Comp> num_set;
+    // Row_Window::push would throw on a ragged row inside a band thread
+    grid_cols(grid);
+
+    auto rows = static_cast<u64>(grid.size());
+    num_bands = static_cast<u32>(std::clamp<u64>(num_bands, 1, rows));
+    auto band_rows = (rows + num_bands - 1) / num_bands;
+
+    vec<Row_Window> windows(num_bands);
 
-    for (i32 r = -1; r <= 1; ++r)
     {
-        for (i32 c = -1; c <= 1; ++c)
-        {
-            if (not is_in_bounds(grid, gear_r + r, gear_c + c))
-                continue;
+        vec<std::jthread> threads;
 
-            for (const auto& num : nums)
+        for (u32 b = 0;
+             b < num_bands;
+             ++b)
+        {
+            threads.emplace_back([&grid, &window = windows[b], b, rows, band_rows]()
             {
-                if (is_suitable(num, gear_r + r, gear_c + c))
+                u64 r0 = std::min(rows, b * band_rows);
+                u64 r1 = std::min(rows, r0 + band_rows);
+                if (r0 == r1)
+                    return;
+
+                u64 first = (r0 > 0) ? r0 - 1 : 0;
+                u64 last = (r1 < rows) ? r1 : rows - 1;
+
+                window.first_owned = r0 - first;
+                window.last_owned = window.first_owned + (r1 - r0) - 1;
+
+                for (u64 r = first; r <= last; ++r)
                 {
-                    num_set.insert(num);
+                    window.push(as_view(grid[r]));
                 }
-            }
+
+                window.finish();
+            });
         }
     }
 
-    if (num_set.size() == 2)
+    Band_Result res;
+
+    for (const auto& window : windows)
     {
-        i32 acc = std::stoi(num_set.begin()->num);
-        acc *= std::stoi(num_set.rbegin()->num);
+        res.part_numbers += window.part_numbers;
+        res.gear_ratios += window.gear_ratios;
+    }
+
+    return res;
+}
+
+/**
+* below this many cells starting the band threads costs more than it saves
+*/
+bool is_large(const Grid& grid)
+{
+    constexpr u64 BAND_THRESHOLD = 4'000'000;
 
-        return acc;
+    return grid.size() * grid.at(0).size() >= BAND_THRESHOLD;
+}
+
+void part1()
+{
+    auto file_path = "res\\input.txt";
+    auto ifs = std::ifstream(file_path);
+
+    auto grid = vec<vec<char>>{};
+
+    for (str line;
+         std::getline(ifs, line);
+         )
+    {
+        auto row = vec<char>{};
+
+        for (char c : line)
+        {
+            row.push_back(c);
+        }
+        grid.push_back(std::move(row));
     }
 
-    return 0;
+    u64 res = is_large(grid)
+        ? solve_in_bands(grid, std::thread::hardware_concurrency()).part_numbers
+        : sum_part_numbers(grid);
+    cout << "part 1 (" << file_path << ") " << res << endl;
 }
 
 void part2()
@@ -349,46 +653,113 @@ void part2()
         grid.push_back(std::move(row));
     }
 
+    u64 res = is_large(grid)
+        ? solve_in_bands(grid, std::thread::hardware_concurrency()).gear_ratios
+        : sum_gear_ratios(grid);
+    cout << "part 2 (" << file_path << ") " << res << endl;
+}
 
-    i32 acc = 0;
-    auto rows = static_cast<i32>(grid.size());
-    auto cols = static_cast<i32>(grid.at(0).size());
+Grid generate_grid(i32 rows, i32 cols, u64 seed)
+{
+    std::mt19937_64 rng {seed};
+    std::uniform_int_distribution<i32> pick {0, 99};
+    constexpr auto symbols = "*#+$*/=*"sv;
 
-    for (i32 r = 0;
-         r < rows;
-         ++r)
+    Grid grid(rows, vec<char>(cols, '.'));
+
+    for (auto& row : grid)
     {
-        // row: "467..114.."
-        for (i32 c = 0;
-             c < cols;
-             ++c)
+        for (i32 c = 0; c < cols; ++c)
         {
-            auto& col = grid.at(r);
-            char ch = col.at(c);
+            auto p = pick(rng);
 
-            if (is_gear(ch))
+            if (p < 25)
             {
-                vec<Num> nums;
-                read_nums_in_row(grid, nums, r - 1);
-                read_nums_in_row(grid, nums, r);
-                read_nums_in_row(grid, nums, r + 1);
-
-                i32 ratio = calculate_gear_ratio(grid, nums, r, c);
-                acc += ratio;
+                // a number of up to three digits, followed by a dot
+                for (i32 d = 0; d <= p % 3 and c < cols; ++d, ++c)
+                {
+                    row[c] = static_cast<char>('0' + pick(rng) % 10);
+                }
+            }
+            else if (p < 35)
+            {
+                row[c] = symbols[p % symbols.size()];
             }
-
         }
     }
 
-    i32 res = acc;
-    cout << "part 2 (" << file_path << ") " << res << endl;
+    return grid;
+}
+
+void benchmark(i32 rows, i32 cols)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto grid = generate_grid(rows, cols, 42);
+    auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto t0 = clock::now();
+    auto part_numbers = sum_part_numbers(grid);
+    auto gear_ratios = sum_gear_ratios(grid);
+    auto t1 = clock::now();
+    auto banded = solve_in_bands(grid, num_threads);
+    auto t2 = clock::now();
+
+    if (banded.part_numbers != part_numbers or
+        banded.gear_ratios != gear_ratios)
+    {
+        throw std::runtime_error("[ERROR] banded result differs from the single threaded one");
+    }
+
+    auto single_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    auto banded_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+    cout << std::format("{}x{} grid: single thread {:.1f} ms, {} bands {:.1f} ms, speedup {:.2f}x",
+                        rows, cols, single_ms, num_threads, banded_ms, single_ms / banded_ms) << endl;
 }
 
-int main()
+void stream(std::istream& is, const char* name)
+{
+    Row_Window window;
+
+    for (str line;
+         std::getline(is, line);
+         )
+    {
+        if (not line.empty() and line.back() == '\r')
+            line.pop_back();
+
+        window.push(line);
+    }
+
+    window.finish();
+
+    cout << "part 1 (" << name << ") " << window.part_numbers << endl;
+    cout << "part 2 (" << name << ") " << window.gear_ratios << endl;
+}
+
+int main(int argc, char* argv[])
 {
 
     try
     {
+        // "day03 -" streams the schematic from stdin
+        if (argc > 1 and argv[1] == "-"sv)
+        {
+            std::ios::sync_with_stdio(false);
+            stream(std::cin, "stdin");
+            return 0;
+        }
+
+        // "day03 bench [rows] [cols]" compares the banded solver with the single threaded one
+        if (argc > 1 and argv[1] == "bench"sv)
+        {
+            auto rows = (argc > 2) ? std::stoi(argv[2]) : 50'000;
+            auto cols = (argc > 3) ? std::stoi(argv[3]) : rows;
+            benchmark(rows, cols);
+            return 0;
+        }
+
         part1();
         part2();
     }
@@ -2,7 +2,9 @@
 
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: https://pvs-studio.com
 
+#include <array>
 #include <assert.h>
+#include <bit>
 #include <cstdint>
 #include <exception>
 #include <filesystem>
@@ -10,6 +12,7 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <queue>
 #include <ranges>
@@ -17,6 +20,7 @@
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 using u8 = uint8_t;
@@ -103,173 +107,267 @@ vector<str> split_string(str_cref line, char sep)
 }
 
 
-void part1()
+/**
+* Set of card numbers, one bit per number in [0, BITS). The default width
+* covers the two digit numbers of the puzzle, decks with larger numbers
+* just need a wider set.
+*/
+template<u32 BITS = 128>
+struct Number_Set
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
+    static_assert(BITS % 64 == 0, "BITS must be a multiple of 64");
 
-    i32 acc {};
+    static constexpr u32 WIDTH = BITS;
 
-    for (str line;
-         std::getline(ifs, line);
-         )
-    {
-        auto parts = split_string(line, ':');
-        assert(parts.size() == 2);
+    std::array<u64, BITS / 64> words {};
 
-        parts = split_string(parts.at(1), '|');
-        assert(parts.size() == 2);
+    void insert(i32 num)
+    {
+        if (num < 0 or static_cast<u32>(num) >= BITS)
+            throw std::out_of_range(std::format("[ERROR] card number {} does not fit in {} bits", num, BITS));
 
-        const auto pattern = std::regex(R"((\d+))");
+        words[num / 64] |= 1ULL << (num % 64);
+    }
 
-        vec<i32> winning_numbers;
-        vec<i32> your_numbers;
+    u32 count_common(const Number_Set& other) const
+    {
+        u32 res = 0;
 
-        // exctract winning numbers
-        auto token = parts.at(0);
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        for (u32 i = 0; i < words.size(); ++i)
         {
-            assert(match.size() == 2);
+            res += std::popcount(words[i] & other.words[i]);
+        }
 
-            winning_numbers.push_back(std::stoi(match[1].str()));
+        return res;
+    }
+};
 
-            token = match.suffix();
-        }
+/**
+* Parses every "Card N: winning | yours" line of input and appends the
+* number of matches of each card to wins, in input order.
+*/
+void parse_cards(string_view input, vec<u8>& wins)
+{
+    auto read_numbers = [](string_view text, Number_Set<>& set)
+    {
+        // stops growing at the set width, so a long number cannot wrap into range
+        constexpr u64 TOO_BIG = Number_Set<>::WIDTH;
 
-        // exctract your numbers
-        token = parts.at(1);
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        u64 begin = 0;
+        u64 num = 0;
+        bool in_number = false;
+
+        auto insert = [&](u64 end)
         {
-            assert(match.size() == 2);
+            if (num >= TOO_BIG)
+                throw std::out_of_range(std::format("[ERROR] card number {} does not fit in {} bits",
+                                                    text.substr(begin, end - begin), TOO_BIG));
 
-            your_numbers.push_back(std::stoi(match[1].str()));
+            set.insert(static_cast<i32>(num));
+            in_number = false;
+        };
 
-            token = match.suffix();
+        for (u64 i = 0;
+             i < text.size();
+             ++i)
+        {
+            auto ch = text[i];
+
+            if (std::isdigit(static_cast<unsigned char>(ch)))
+            {
+                if (not in_number)
+                {
+                    begin = i;
+                    num = 0;
+                    in_number = true;
+                }
+
+                num = std::min(TOO_BIG, num * 10 + (ch - '0'));
+            }
+            else if (in_number)
+            {
+                insert(i);
+            }
         }
 
-        vec<i32> common;
-        std::ranges::copy_if(winning_numbers, std::back_inserter(common),
-                             [&your_numbers](i32 val)
-        {
-            return std::ranges::find(your_numbers, val) != your_numbers.end();
-        });
+        if (in_number)
+            insert(text.size());
+    };
+
+    while (not input.empty())
+    {
+        auto eol = input.find('\n');
+        auto line = input.substr(0, eol);
+        input.remove_prefix(eol == string_view::npos ? input.size() : eol + 1);
+
+        if (not line.empty() and line.back() == '\r')
+            line.remove_suffix(1);
 
-        if (common.size() > 0)
+        if (line.empty())
+            continue;
+
+        auto colon = line.find(':');
+        auto bar = line.find('|');
+
+        if (colon == string_view::npos or
+            bar == string_view::npos or
+            bar < colon)
         {
-            i32 res = std::pow(2, common.size() - 1);
-            acc += res;
+            throw std::runtime_error(std::format("[ERROR] malformed card <{}>", line));
         }
-        int s = 0;
-    }
 
+        Number_Set<> winning_numbers;
+        Number_Set<> your_numbers;
 
-    i32 res = acc;
-    cout << "part 1 (" << file_path << ") " << res << endl;
-}
+        read_numbers(line.substr(colon + 1, bar - colon - 1), winning_numbers);
+        read_numbers(line.substr(bar + 1), your_numbers);
 
-struct Card
-{
-    i32 num {};
-    i32 wins {};
-};
+        wins.push_back(static_cast<u8>(winning_numbers.count_common(your_numbers)));
+    }
+}
 
-i32 compute_scratchcards(const vec<Card>& scratchcards,
-                         const Card& card)
+/**
+* Same as parse_cards, with input cut at line boundaries into one chunk
+* per thread. The per chunk results are concatenated in order.
+*/
+vec<u8> parse_cards(string_view input, u32 num_chunks)
 {
-    i32 counter {card.wins};
+    num_chunks = std::max(1u, num_chunks);
 
-    for (auto j = 0;
-         j < card.wins;
-         ++j)
+    if (num_chunks == 1)
     {
-        counter += compute_scratchcards(scratchcards,
-                                        scratchcards[j + card.num]);
+        vec<u8> wins;
+        parse_cards(input, wins);
+        return wins;
     }
 
-    return counter;
-}
+    vec<string_view> chunks;
+    u64 begin = 0;
 
+    for (u32 k = 1;
+         k <= num_chunks and begin < input.size();
+         ++k)
+    {
+        u64 end = input.size();
 
+        if (k < num_chunks)
+        {
+            end = std::max<u64>(begin, input.size() * k / num_chunks);
+            end = input.find('\n', end);
+            end = (end == string_view::npos) ? input.size() : end + 1;
+        }
 
-void part2()
-{
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
+        chunks.push_back(input.substr(begin, end - begin));
+        begin = end;
+    }
 
-    i32 id = 1;
+    vec<vec<u8>> partial(chunks.size());
 
-    vec<Card> scratchcards;
+    // a bad card throws in its worker, the first error is rethrown here
+    vec<std::exception_ptr> errors(chunks.size());
 
-    // collect all the cards
-    for (str line;
-         std::getline(ifs, line);
-         )
     {
-        Card card;
-        card.num = id++;
-
-        auto parts = split_string(line, ':');
-        assert(parts.size() == 2);
-
-        parts = split_string(parts.at(1), '|');
-        assert(parts.size() == 2);
-
-        const auto pattern = std::regex(R"((\d+))");
-        vec<i32> winning_numbers;
-        // exctract winning numbers
-        auto token = parts.at(0);
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        vec<std::jthread> threads;
+
+        for (u64 i = 0;
+             i < chunks.size();
+             ++i)
         {
-            assert(match.size() == 2);
+            threads.emplace_back([&chunk = chunks[i], &wins = partial[i], &error = errors[i]]()
+            {
+                try
+                {
+                    parse_cards(chunk, wins);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            });
+        }
+    }
 
-            winning_numbers.push_back(std::stoi(match[1].str()));
+    for (const auto& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
 
-            token = match.suffix();
-        }
+    vec<u8> wins;
 
+    for (const auto& part : partial)
+    {
+        wins.insert(wins.end(), part.begin(), part.end());
+    }
 
-        vec<i32> your_numbers;
-        // exctract your numbers
-        token = parts.at(1);
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
-        {
-            assert(match.size() == 2);
+    return wins;
+}
 
-            your_numbers.push_back(std::stoi(match[1].str()));
+void part1(const char* file_path, const vec<u8>& wins)
+{
+    u64 acc {};
 
-            token = match.suffix();
-        }
+    for (auto matches : wins)
+    {
+        if (matches >= 64)
+            throw std::overflow_error("[ERROR] card points do not fit in 64 bits");
 
-        vec<i32> common;
-        std::ranges::copy_if(winning_numbers, std::back_inserter(common),
-                             [&](i32 val)
+        if (matches > 0)
         {
-            return std::ranges::find(your_numbers, val) != your_numbers.end();
-        });
+            acc += 1ULL << (matches - 1);
+        }
+    }
 
-        card.wins = common.size();
+    u64 res = acc;
+    cout << "part 1 (" << file_path << ") " << res << endl;
+}
 
-        scratchcards.push_back(std::move(card));
-        int s = 0;
-    }
+u64 checked_add(u64 a, u64 b)
+{
+    if (b > std::numeric_limits<u64>::max() - a)
+        throw std::overflow_error("[ERROR] scratchcard count does not fit in 64 bits");
+
+    return a + b;
+}
+
+/**
+* Every copy of card i wins one copy of each of the next wins[i] cards,
+* so copies only ever flow forward: one pass is enough. won holds the
+* copies won by earlier cards that still reach the current card, and
+* expiring[i] the part of it that stops at card i.
+*/
+u64 count_scratchcards(const vec<u8>& wins)
+{
+    auto num_cards = wins.size();
 
+    vec<u64> expiring(num_cards + 1, 0);
+    u64 won = 0;
+    u64 total = 0;
 
-    i32 counter = scratchcards.size();
-    for (const auto& card : scratchcards)
+    for (u64 i = 0;
+         i < num_cards;
+         ++i)
     {
-        counter += compute_scratchcards(scratchcards,
-                                        card);
+        won -= expiring[i];
+
+        u64 copies = checked_add(won, 1);
+        total = checked_add(total, copies);
+
+        if (wins[i] > 0)
+        {
+            auto end = std::min<u64>(num_cards, i + 1 + wins[i]);
+
+            won = checked_add(won, copies);
+            expiring[end] = checked_add(expiring[end], copies);
+        }
     }
 
-    i32 res = counter;
+    return total;
+}
+
+void part2(const char* file_path, const vec<u8>& wins)
+{
+    u64 res = count_scratchcards(wins);
 
     cout << "part 2 (" << file_path << ") " << res << endl;
 }
@@ -280,8 +378,17 @@ int main()
 
     try
     {
-        part1();
-        part2();
+        auto file_path = "res\\input.txt";
+        auto input = read_file(file_path);
+
+        // below a few MB a single thread parses faster than it takes to start the others
+        constexpr u64 PARALLEL_PARSE_SIZE = 4 * 1024 * 1024;
+        auto num_chunks = (input.size() >= PARALLEL_PARSE_SIZE) ? std::thread::hardware_concurrency() : 1;
+
+        auto wins = parse_cards(input, num_chunks);
+
+        part1(file_path, wins);
+        part2(file_path, wins);
     }
     catch (const std::exception& e)
     {
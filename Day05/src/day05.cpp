@@ -2,7 +2,12 @@
 
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: https://pvs-studio.com
 
+#include <algorithm>
+#include <array>
 #include <assert.h>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <filesystem>
@@ -12,14 +17,28 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <queue>
+#include <random>
 #include <ranges>
 #include <regex>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, so the kernels are always
+// built there and picked at run time; elsewhere only when the target has AVX2
+#if defined(_MSC_VER) and (defined(_M_X64) or defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define AVX2_KERNELS 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define AVX2_KERNELS 1
+#endif
+
 using u8 = uint8_t;
 using u16 = uint16_t;
 using u32 = uint32_t;
@@ -197,10 +216,11 @@ set<Conversion_Table, Conversion_Table_Comp> parse_mappings(std::ifstream& ifs)
     return mappings;
 }
 
-void part1()
+Almanac read_almanac(const char* file_path)
 {
-    auto file_path = "res\\input.txt";
     auto ifs = std::ifstream(file_path);
+    if (not ifs.is_open())
+        throw std::format("Cannot open file <{}>", file_path);
 
     Almanac almanac;
 
@@ -224,125 +244,1327 @@ void part1()
 
     }
 
-    u64 res = std::numeric_limits<u64>::max();
+    return almanac;
+}
+
+enum class Layout
+{
+    Sorted,     // plain sorted arrays, binary search
+    Eytzinger,  // same arrays in BFS order of a complete search tree
+};
+
+/**
+* A Map as flat arrays, one entry per table with sources that do not
+* overlap (where two tables overlap the first one in src order wins, the
+* second is clipped). A lookup finds the last table with src <= seed.
+*
+* With the Eytzinger layout the entries are stored in BFS order of the
+* search tree starting at index 1: the first levels of the tree share a
+* few cache lines and the descent has no data dependent branch.
+*/
+struct Flat_Map
+{
+    Layout layout {Layout::Sorted};
+
+    vec<u64> src;
+    vec<u64> len;
+    vec<u64> delta;
 
-    for (auto seed : almanac.seeds)
+    u64 operator()(u64 seed) const
     {
-        //cout << "seed " << seed << endl;
+        u64 i = 0;
 
-        for (const Map& map : almanac.maps)
+        if (layout == Layout::Sorted)
         {
-            const Conversion_Table* ct_to_use = nullptr;
-
-            for (const Conversion_Table& ct : map.mappings)
-            {
-                if (is_between(seed, ct.src, ct.src + ct.len - 1))
-                {
-                    ct_to_use = &ct;
-                    break;
-                }
-            }
+            auto it = std::upper_bound(src.begin(), src.end(), seed);
+            if (it == src.begin())
+                return seed;
 
-            //cout << "    " << seed << " -> ";
-            if (ct_to_use != nullptr)
+            i = std::distance(src.begin(), it) - 1;
+        }
+        else
+        {
+            u64 k = 1;
+            while (k < src.size())
             {
-                auto offset = seed - ct_to_use->src;
-                auto new_seed = ct_to_use->dest + offset;
-                seed = new_seed;
+                k = 2 * k + (src[k] <= seed);
             }
-            // else seed maps to itself
 
-            //cout << seed << endl;
+            // the last right turn is the greatest src <= seed
+            i = k >> (std::countr_zero(k) + 1);
+            if (i == 0)
+                return seed;
         }
 
-        res = std::min(res, seed);
+        return (seed - src[i] < len[i]) ? seed + delta[i] : seed;
     }
+};
 
-    cout << "part 1 (" << file_path << ") " << res << endl;
+Flat_Map flatten(const Map& map, Layout layout)
+{
+    Flat_Map sorted;
+    u64 curr = 0;
+
+    for (const Conversion_Table& ct : map.mappings)
+    {
+        auto ct_end = ct.src + ct.len;
+        if (ct_end <= curr)
+            continue;
+
+        auto start = std::max(curr, ct.src);
+
+        sorted.src.push_back(start);
+        sorted.len.push_back(ct_end - start);
+        sorted.delta.push_back(ct.dest - ct.src);
+
+        curr = ct_end;
+    }
+
+    if (layout == Layout::Sorted)
+        return sorted;
+
+    Flat_Map eytz;
+    eytz.layout = Layout::Eytzinger;
+
+    auto n = sorted.src.size();
+    eytz.src.resize(n + 1);
+    eytz.len.resize(n + 1);
+    eytz.delta.resize(n + 1);
+
+    // an in-order visit of the implicit tree hands out the sorted entries
+    u64 next = 0;
+    auto fill = [&](auto& self, u64 k) -> void
+    {
+        if (k > n)
+            return;
+
+        self(self, 2 * k);
+
+        eytz.src[k] = sorted.src[next];
+        eytz.len[k] = sorted.len[next];
+        eytz.delta[k] = sorted.delta[next];
+        ++next;
+
+        self(self, 2 * k + 1);
+    };
+    fill(fill, 1);
+
+    return eytz;
 }
 
-void part2()
+vec<Flat_Map> flatten(const Almanac& almanac, Layout layout)
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
+    vec<Flat_Map> res;
 
-    Almanac almanac;
+    for (const Map& map : almanac.maps)
+    {
+        res.push_back(flatten(map, layout));
+    }
 
-    // first line is seeds
-    almanac.seeds = parse_seeds(ifs);
+    return res;
+}
 
-    // parsing mappings
-    for (str line;
-         std::getline(ifs, line);
-         )
+/**
+* walks a single seed through all the maps
+*/
+u64 map_seed(const vec<Flat_Map>& maps, u64 seed)
+{
+    for (const auto& map : maps)
     {
-        if (contains(line, "map:"))
+        seed = map(seed);
+    }
+
+    return seed;
+}
+
+constexpr u64 SEED_BLOCK = 1024;
+
+/**
+* true when the CPU and the OS support AVX2
+*/
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER) and defined(AVX2_KERNELS)
+    std::array<int, 4> info {};
+
+    __cpuid(info.data(), 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX and OSXSAVE, then the OS must save the YMM registers
+    __cpuid(info.data(), 1);
+    if ((info[2] & (1 << 27)) == 0 or (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info.data(), 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(AVX2_KERNELS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+static const bool HAS_AVX2 = cpu_has_avx2();
+
+#if defined(AVX2_KERNELS)
+/**
+* map_block with AVX2, four seeds per compare and select
+*/
+void map_block_avx2(const Flat_Map& map, const u64* in, u64* out, u64 count)
+{
+    // AVX2 only has a signed 64 bit compare: flipping the sign bit of
+    // both sides turns it into an unsigned one
+    const auto sign = _mm256_set1_epi64x(std::numeric_limits<i64>::min());
+
+    for (u64 j = 0; j < map.src.size(); ++j)
+    {
+        const auto src = _mm256_set1_epi64x(map.src[j]);
+        const auto len = _mm256_xor_si256(_mm256_set1_epi64x(map.len[j]), sign);
+        const auto delta = _mm256_set1_epi64x(map.delta[j]);
+
+        for (u64 i = 0; i < count; i += 4)
         {
-            Map map;
+            auto seed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            auto curr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + i));
 
-            map.name = split_string(line, ' ')[0];
-            map.mappings = parse_mappings(ifs);
+            // seed - src < len, unsigned
+            auto offset = _mm256_xor_si256(_mm256_sub_epi64(seed, src), sign);
+            auto inside = _mm256_cmpgt_epi64(len, offset);
 
-            almanac.maps.push_back(std::move(map));
+            curr = _mm256_blendv_epi8(curr, _mm256_add_epi64(seed, delta), inside);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), curr);
+        }
+    }
+}
+#endif
+
+void map_block_scalar(const Flat_Map& map, const u64* in, u64* out, u64 count)
+{
+    for (u64 j = 0; j < map.src.size(); ++j)
+    {
+        const auto src = map.src[j];
+        const auto len = map.len[j];
+        const auto delta = map.delta[j];
+
+        for (u64 i = 0; i < count; ++i)
+        {
+            out[i] = (in[i] - src < len) ? in[i] + delta : out[i];
         }
+    }
+}
 
+/**
+* Maps count seeds (count a multiple of 4 up to SEED_BLOCK) through one
+* map, with the sorted tables as structure of arrays. Every table is
+* tested against every seed with a compare and a select instead of a
+* search: the tables do not overlap, so at most one of them matches.
+*/
+void map_block(const Flat_Map& map, const u64* in, u64* out, u64 count)
+{
+    std::copy(in, in + count, out);
+
+#if defined(AVX2_KERNELS)
+    if (HAS_AVX2)
+    {
+        map_block_avx2(map, in, out, count);
+        return;
+    }
+#endif
+
+    map_block_scalar(map, in, out, count);
+}
+
+/**
+* lowest location of the seeds [start, start + count), count <= SEED_BLOCK
+*/
+u64 lowest_location_in_block(const vec<Flat_Map>& maps, u64 start, u64 count)
+{
+    alignas(32) std::array<u64, SEED_BLOCK> a {};
+    alignas(32) std::array<u64, SEED_BLOCK> b;
+
+    // round up to whole vectors, the padding seeds repeat the last one
+    auto padded = (count + 3) & ~u64 {3};
+    for (u64 i = 0; i < padded; ++i)
+    {
+        a[i] = start + std::min(i, count - 1);
+    }
+
+    auto* in = a.data();
+    auto* out = b.data();
+
+    for (const auto& map : maps)
+    {
+        map_block(map, in, out, padded);
+        std::swap(in, out);
     }
 
-    u64 res = std::numeric_limits<u64>::max();
+    return *std::min_element(in, in + padded);
+}
+
+/**
+* part 2 the slow way: every seed of every range, through the block kernel.
+* The seed ranges are cut in chunks that the threads pull from a shared
+* counter, every thread keeps its own minimum and they are reduced at the
+* end. Only useful to check the interval engine.
+*/
+u64 lowest_location_brute_force(const Almanac& almanac, u32 num_threads)
+{
+    auto maps = flatten(almanac, Layout::Sorted);
+
+    // seed ranges laid end to end: range i starts at offsets[i]
+    vec<u64> starts;
+    vec<u64> offsets {0};
 
     for (u64 i = 0;
-         i < almanac.seeds.size() - 1;
+         i + 1 < almanac.seeds.size();
          i += 2)
     {
-        auto start = almanac.seeds[i];
-        auto end = almanac.seeds[i] + almanac.seeds[i + 1];
+        starts.push_back(almanac.seeds[i]);
+        offsets.push_back(offsets.back() + almanac.seeds[i + 1]);
+    }
 
-        for (u64 seed = start;
-             seed < end;
-             ++seed)
-        {
-            auto current_seed = seed;
+    constexpr u64 CHUNK = 64 * SEED_BLOCK;
+    auto total = offsets.back();
 
-            //cout << "seed " << current_seed << endl;
+    std::atomic<u64> next {0};
+    num_threads = std::max(1u, num_threads);
+    vec<u64> lowest(num_threads, std::numeric_limits<u64>::max());
 
-            for (const Map& map : almanac.maps)
-            {
-                const Conversion_Table* ct_to_use = nullptr;
+    {
+        vec<std::jthread> threads;
 
-                for (const Conversion_Table& ct : map.mappings)
+        for (u32 t = 0;
+             t < num_threads;
+             ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (u64 begin = next.fetch_add(CHUNK);
+                     begin < total;
+                     begin = next.fetch_add(CHUNK))
                 {
-                    if (is_between(current_seed, ct.src, ct.src + ct.len - 1))
+                    auto end = std::min(total, begin + CHUNK);
+
+                    // a chunk can span several seed ranges
+                    auto r = std::distance(offsets.begin(), std::upper_bound(offsets.begin(), offsets.end(), begin)) - 1;
+
+                    for (auto pos = begin; pos < end; )
                     {
-                        ct_to_use = &ct;
-                        break;
+                        while (offsets[r + 1] <= pos)
+                            ++r;
+
+                        auto count = std::min({SEED_BLOCK, end - pos, offsets[r + 1] - pos});
+                        auto location = lowest_location_in_block(maps, starts[r] + (pos - offsets[r]), count);
+
+                        lowest[t] = std::min(lowest[t], location);
+                        pos += count;
                     }
                 }
+            });
+        }
+    }
 
-                //cout << "    " << current_seed << " -> ";
-                if (ct_to_use != nullptr)
-                {
-                    auto offset = current_seed - ct_to_use->src;
-                    auto new_seed = ct_to_use->dest + offset;
-                    current_seed = new_seed;
-                }
-                // else seed maps to itself
+    return std::ranges::min(lowest);
+}
+
+/**
+* half open range of values [start, end)
+*/
+struct Range
+{
+    u64 start;
+    u64 end;
+};
+
+/**
+* sorts ranges and merges the ones that overlap or touch
+*/
+void normalize(vec<Range>& ranges)
+{
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Range& lhs, const Range& rhs)
+    {
+        return lhs.start < rhs.start;
+    });
+
+    vec<Range> merged;
+
+    for (const auto& range : ranges)
+    {
+        if (not merged.empty() and range.start <= merged.back().end)
+        {
+            merged.back().end = std::max(merged.back().end, range.end);
+        }
+        else
+        {
+            merged.push_back(range);
+        }
+    }
 
-                //cout << current_seed << endl;
+    ranges = std::move(merged);
+}
+
+/**
+* Pushes whole ranges through a map: every range is split at the bounds of
+* the conversion tables it overlaps, the pieces inside a table are shifted
+* and the gaps map to themselves. Tables are visited in src order, so a
+* value covered by two tables goes through the first one, like map_seed.
+*/
+vec<Range> map_ranges(const Map& map, const vec<Range>& ranges)
+{
+    vec<Range> res;
+
+    for (const auto& range : ranges)
+    {
+        u64 curr = range.start;
+
+        for (const Conversion_Table& ct : map.mappings)
+        {
+            if (curr == range.end or ct.src >= range.end)
+                break;
+
+            auto ct_end = ct.src + ct.len;
+            if (ct_end <= curr)
+                continue;
+
+            if (curr < ct.src)
+            {
+                res.push_back({curr, ct.src});
+                curr = ct.src;
             }
 
-            res = std::min(res, current_seed);
+            auto stop = std::min(range.end, ct_end);
+            res.push_back({ct.dest + (curr - ct.src), ct.dest + (stop - ct.src)});
+            curr = stop;
+        }
+
+        if (curr < range.end)
+        {
+            res.push_back({curr, range.end});
         }
     }
 
-    cout << "part 2 (" << file_path << ") " << res << endl;
+    normalize(res);
+
+    return res;
 }
 
+/**
+* the part 2 seed ranges, sorted and merged
+*/
+vec<Range> seed_ranges(const Almanac& almanac)
+{
+    vec<Range> ranges;
+
+    for (u64 i = 0;
+         i + 1 < almanac.seeds.size();
+         i += 2)
+    {
+        if (almanac.seeds[i + 1] > 0)
+        {
+            ranges.push_back({almanac.seeds[i], almanac.seeds[i] + almanac.seeds[i + 1]});
+        }
+    }
 
-int main()
+    normalize(ranges);
+
+    return ranges;
+}
+
+/**
+* part 2 with whole seed ranges: the cost depends on the number of ranges
+* and tables, not on how many seeds the ranges hold
+*/
+u64 lowest_location(const Almanac& almanac)
 {
+    auto ranges = seed_ranges(almanac);
 
-    try
+    for (const Map& map : almanac.maps)
+    {
+        ranges = map_ranges(map, ranges);
+    }
+
+    return ranges.empty() ? std::numeric_limits<u64>::max() : ranges.front().start;
+}
+
+/**
+* Piecewise linear function over all of u64: segment i covers the values
+* from starts[i] up to the next start and adds deltas[i] to them (mod 2^64,
+* so a negative shift is stored as its two's complement). starts[0] is 0.
+*/
+struct Piecewise
+{
+    vec<u64> starts;
+    vec<u64> deltas;
+
+    u64 operator()(u64 x) const
+    {
+        auto it = std::upper_bound(starts.begin(), starts.end(), x);
+        auto i = std::distance(starts.begin(), it) - 1;
+
+        return x + deltas[i];
+    }
+
+    // last value covered by segment i
+    u64 last(u64 i) const
+    {
+        return (i + 1 < starts.size()) ? starts[i + 1] - 1 : std::numeric_limits<u64>::max();
+    }
+
+    // appends a segment, dropping the empty and redundant ones
+    void push(u64 start, u64 delta)
+    {
+        if (not starts.empty() and starts.back() == start)
+        {
+            starts.pop_back();
+            deltas.pop_back();
+        }
+
+        if (not deltas.empty() and deltas.back() == delta)
+            return;
+
+        starts.push_back(start);
+        deltas.push_back(delta);
+    }
+};
+
+/**
+* the map as a function, first matching table wins like in map_seed
+*/
+Piecewise to_piecewise(const Map& map)
+{
+    Piecewise f;
+    f.push(0, 0);
+
+    u64 curr = 0;
+
+    for (const Conversion_Table& ct : map.mappings)
+    {
+        auto ct_end = ct.src + ct.len;
+        if (ct_end <= curr)
+            continue;
+
+        auto start = std::max(curr, ct.src);
+        if (start > curr)
+        {
+            f.push(curr, 0);
+        }
+
+        f.push(start, ct.dest - ct.src);
+        curr = ct_end;
+    }
+
+    f.push(curr, 0);
+
+    return f;
+}
+
+/**
+* g(f(x)) for x in [lo, hi] only, the first segment starts at lo: every
+* segment of f is split where its image crosses a breakpoint of g
+*/
+Piecewise compose(const Piecewise& f, const Piecewise& g, u64 lo, u64 hi)
+{
+    Piecewise res;
+
+    auto first = std::upper_bound(f.starts.begin(), f.starts.end(), lo);
+
+    for (auto i = static_cast<u64>(std::distance(f.starts.begin(), first) - 1);
+         i < f.starts.size() and f.starts[i] <= hi;
+         ++i)
+    {
+        auto d = f.deltas[i];
+        auto x_lo = std::max(lo, f.starts[i]);
+        auto y_lo = x_lo + d;
+        auto y_hi = std::min(hi, f.last(i)) + d;
+
+        auto it = std::upper_bound(g.starts.begin(), g.starts.end(), y_lo);
+        auto j = static_cast<u64>(std::distance(g.starts.begin(), it) - 1);
+
+        for (;; ++j)
+        {
+            auto piece_last = std::min(y_hi, g.last(j));
+            res.push(y_lo - d, d + g.deltas[j]);
+
+            if (piece_last == y_hi)
+                break;
+
+            y_lo = piece_last + 1;
+        }
+    }
+
+    return res;
+}
+
+Piecewise compose(const Piecewise& f, const Piecewise& g)
+{
+    return compose(f, g, 0, std::numeric_limits<u64>::max());
+}
+
+/**
+* replaces f on [lo, hi] with part, which covers exactly that range; only
+* the segments inside it move, the rest of f is kept as it is
+*/
+void splice(Piecewise& f, const Piecewise& part, u64 lo, u64 hi)
+{
+    constexpr auto MAX = std::numeric_limits<u64>::max();
+
+    // the segments starting inside [lo, hi + 1] are replaced
+    auto a = static_cast<u64>(std::distance(f.starts.begin(), std::lower_bound(f.starts.begin(), f.starts.end(), lo)));
+    auto b = static_cast<u64>(std::distance(f.starts.begin(), std::upper_bound(f.starts.begin(), f.starts.end(), (hi == MAX) ? MAX : hi + 1)));
+
+    Piecewise repl;
+
+    // pushed after the segment before lo, so an equal delta is merged into it
+    if (a > 0)
+        repl.push(f.starts[a - 1], f.deltas[a - 1]);
+
+    for (u64 i = 0;
+         i < part.starts.size();
+         ++i)
+    {
+        repl.push(part.starts[i], part.deltas[i]);
+    }
+
+    // f carries on from hi + 1 with the delta it had there, which differs
+    // from the delta of the next segment since f is normalized
+    if (hi != MAX)
+        repl.push(hi + 1, f.deltas[b - 1]);
+
+    auto skip = (a > 0) ? 1 : 0;
+
+    f.starts.erase(f.starts.begin() + a, f.starts.begin() + b);
+    f.deltas.erase(f.deltas.begin() + a, f.deltas.begin() + b);
+
+    f.starts.insert(f.starts.begin() + a, repl.starts.begin() + skip, repl.starts.end());
+    f.deltas.insert(f.deltas.begin() + a, repl.deltas.begin() + skip, repl.deltas.end());
+}
+
+/**
+* all the maps of the almanac composed into one function:
+* a seed location is then a single binary search away
+*/
+Piecewise compose_almanac(const Almanac& almanac)
+{
+    Piecewise f;
+    f.push(0, 0);
+
+    for (const Map& map : almanac.maps)
+    {
+        f = compose(f, to_piecewise(map));
+    }
+
+    return f;
+}
+
+/**
+* f applied to every seed, seeds split in one contiguous block per thread
+*/
+vec<u64> map_seeds(const Piecewise& f, const vec<u64>& seeds, u32 num_threads)
+{
+    vec<u64> res(seeds.size());
+
+    num_threads = std::max(1u, num_threads);
+    auto block = (seeds.size() + num_threads - 1) / num_threads;
+
+    {
+        vec<std::jthread> threads;
+
+        for (u64 begin = 0;
+             begin < seeds.size();
+             begin += block)
+        {
+            auto end = std::min(seeds.size(), begin + block);
+
+            threads.emplace_back([&f, &seeds, &res, begin, end]()
+            {
+                for (u64 i = begin; i < end; ++i)
+                {
+                    res[i] = f(seeds[i]);
+                }
+            });
+        }
+    }
+
+    return res;
+}
+
+/**
+* Answers "lowest location" queries while the tables and the seeds change.
+* Every map is kept as a Piecewise function and the compositions are cached
+* in a segment tree over the map order: a leaf is one map, a node is its
+* left child followed by its right child and the root is the whole almanac.
+* A table update only touches the nodes on the path from its map to the
+* root, and in those only the inputs whose result can change: the range of
+* the table at the leaf, followed up the tree (through the left sibling's
+* preimage when coming from a right child). Those ranges are recomposed
+* and spliced in, the rest of every node is kept.
+*/
+struct Almanac_Service
+{
+    explicit Almanac_Service(const Almanac& almanac)
+        : maps {almanac.maps}
+        , seeds {seed_ranges(almanac)}
     {
+        while (leaves < maps.size())
+        {
+            leaves *= 2;
+        }
+
+        Piecewise identity;
+        identity.push(0, 0);
+
+        tree.assign(2 * leaves, identity);
+
+        for (u64 i = 0; i < maps.size(); ++i)
+        {
+            tree[leaves + i] = to_piecewise(maps[i]);
+        }
+
+        for (u64 node = leaves - 1; node >= 1; --node)
+        {
+            tree[node] = compose(tree[2 * node], tree[2 * node + 1]);
+        }
+    }
+
+    // replaces the table with the same src, if any
+    void add_conversion(string_view map_name, const Conversion_Table& ct)
+    {
+        auto i = find_map(map_name);
+        vec<Span> changed;
+
+        if (auto it = maps[i].mappings.find(ct); it != maps[i].mappings.end())
+        {
+            add_span(changed, *it);
+            maps[i].mappings.erase(it);
+        }
+
+        maps[i].mappings.insert(ct);
+        add_span(changed, ct);
+
+        update(i, std::move(changed));
+    }
+
+    void remove_conversion(string_view map_name, u64 src)
+    {
+        auto i = find_map(map_name);
+
+        auto it = maps[i].mappings.find(Conversion_Table {0, src, 0});
+        if (it == maps[i].mappings.end())
+            throw std::format("no table with src {} in map <{}>", src, map_name);
+
+        vec<Span> changed;
+        add_span(changed, *it);
+        maps[i].mappings.erase(it);
+
+        update(i, std::move(changed));
+    }
+
+    void add_seeds(Range range)
+    {
+        if (range.start < range.end)
+        {
+            seeds.push_back(range);
+            normalize(seeds);
+        }
+    }
+
+    void remove_seeds(Range range)
+    {
+        vec<Range> res;
+
+        for (const auto& seed : seeds)
+        {
+            if (seed.start < range.start)
+                res.push_back({seed.start, std::min(seed.end, range.start)});
+
+            if (seed.end > range.end)
+                res.push_back({std::max(seed.start, range.end), seed.end});
+        }
+
+        seeds = std::move(res);
+    }
+
+    /**
+    * every segment of the composed function is increasing, so the lowest
+    * location of a seed range is at the start of one of the segments it
+    * overlaps (or at the start of the range)
+    */
+    u64 lowest_location() const
+    {
+        const auto& f = tree[1];
+        u64 res = std::numeric_limits<u64>::max();
+
+        for (const auto& range : seeds)
+        {
+            auto it = std::upper_bound(f.starts.begin(), f.starts.end(), range.start);
+            auto i = static_cast<u64>(std::distance(f.starts.begin(), it) - 1);
+
+            for (; i < f.starts.size() and f.starts[i] < range.end; ++i)
+            {
+                auto first = std::max(range.start, f.starts[i]);
+                res = std::min(res, first + f.deltas[i]);
+            }
+        }
+
+        return res;
+    }
+
+    // the current state as a plain almanac
+    Almanac almanac() const
+    {
+        Almanac res;
+        res.maps = maps;
+
+        for (const auto& range : seeds)
+        {
+            res.seeds.push_back(range.start);
+            res.seeds.push_back(range.end - range.start);
+        }
+
+        return res;
+    }
+
+private:
+
+    vec<Map> maps;
+    vec<Range> seeds;
+
+    u64 leaves {1};
+    vec<Piecewise> tree;
+
+    u64 find_map(string_view map_name) const
+    {
+        for (u64 i = 0; i < maps.size(); ++i)
+        {
+            if (maps[i].name == map_name)
+                return i;
+        }
+
+        throw std::format("unknown map <{}>", map_name);
+    }
+
+    // inputs [lo, hi] of a node whose result may have changed
+    struct Span
+    {
+        u64 lo;
+        u64 hi;
+    };
+
+    static void add_span(vec<Span>& spans, const Conversion_Table& ct)
+    {
+        if (ct.len > 0)
+            spans.push_back({ct.src, ct.src + (ct.len - 1)});
+    }
+
+    // sorts spans and merges the ones that overlap or touch
+    static void merge_spans(vec<Span>& spans)
+    {
+        std::sort(spans.begin(), spans.end(),
+                  [](const Span& lhs, const Span& rhs)
+        {
+            return lhs.lo < rhs.lo;
+        });
+
+        vec<Span> merged;
+
+        for (const auto& span : spans)
+        {
+            if (not merged.empty() and (merged.back().hi == std::numeric_limits<u64>::max() or span.lo <= merged.back().hi + 1))
+            {
+                merged.back().hi = std::max(merged.back().hi, span.hi);
+            }
+            else
+            {
+                merged.push_back(span);
+            }
+        }
+
+        spans = std::move(merged);
+    }
+
+    // the inputs of f whose image falls into the spans
+    static vec<Span> preimage(const Piecewise& f, const vec<Span>& spans)
+    {
+        vec<Span> res;
+
+        for (u64 k = 0;
+             k < f.starts.size();
+             ++k)
+        {
+            auto d = f.deltas[k];
+            auto y_lo = f.starts[k] + d;
+            auto y_hi = f.last(k) + d;
+
+            // first span that does not end before the image starts
+            auto it = std::lower_bound(spans.begin(), spans.end(), y_lo,
+                                       [](const Span& span, u64 y) { return span.hi < y; });
+
+            for (; it != spans.end() and it->lo <= y_hi; ++it)
+            {
+                res.push_back({std::max(y_lo, it->lo) - d, std::min(y_hi, it->hi) - d});
+            }
+        }
+
+        merge_spans(res);
+        return res;
+    }
+
+    void update(u64 i, vec<Span> changed)
+    {
+        auto node = leaves + i;
+        tree[node] = to_piecewise(maps[i]);
+
+        merge_spans(changed);
+
+        for (;
+             node > 1 and not changed.empty();
+             node /= 2)
+        {
+            auto parent = node / 2;
+
+            // a right child sees the inputs of the parent through its left sibling
+            if (node % 2 == 1)
+                changed = preimage(tree[node - 1], changed);
+
+            for (const auto& span : changed)
+            {
+                splice(tree[parent], compose(tree[2 * parent], tree[2 * parent + 1], span.lo, span.hi), span.lo, span.hi);
+            }
+        }
+    }
+};
+
+/**
+* A map read backwards. A value y can come from several sources: every
+* table whose destination range holds y, plus y itself when no table
+* covers y on the source side.
+*/
+struct Inverse_Map
+{
+    // tables sorted by destination
+    vec<u64> dest;
+    vec<u64> len;
+    vec<u64> delta;
+    u64 max_len {0};
+
+    // the forward map, to tell which values map to themselves
+    Flat_Map forward;
+
+    template<typename Fn>
+    bool any_preimage(u64 y, Fn&& fn) const
+    {
+        auto i = std::distance(forward.src.begin(), std::upper_bound(forward.src.begin(), forward.src.end(), y));
+        bool covered = (i > 0) and (y - forward.src[i - 1] < forward.len[i - 1]);
+
+        if (not covered and fn(y))
+            return true;
+
+        // only tables starting less than max_len before y can hold it
+        auto j = std::distance(dest.begin(), std::upper_bound(dest.begin(), dest.end(), y));
+        for (; j > 0 and y - dest[j - 1] < max_len; --j)
+        {
+            if (y - dest[j - 1] < len[j - 1] and fn(y - delta[j - 1]))
+                return true;
+        }
+
+        return false;
+    }
+};
+
+Inverse_Map invert(const Map& map)
+{
+    Inverse_Map inv;
+    inv.forward = flatten(map, Layout::Sorted);
+
+    vec<u64> order(inv.forward.src.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    const auto& fwd = inv.forward;
+    std::sort(order.begin(), order.end(),
+              [&fwd](u64 lhs, u64 rhs)
+    {
+        return fwd.src[lhs] + fwd.delta[lhs] < fwd.src[rhs] + fwd.delta[rhs];
+    });
+
+    for (auto i : order)
+    {
+        inv.dest.push_back(fwd.src[i] + fwd.delta[i]);
+        inv.len.push_back(fwd.len[i]);
+        inv.delta.push_back(fwd.delta[i]);
+        inv.max_len = std::max(inv.max_len, fwd.len[i]);
+    }
+
+    return inv;
+}
+
+bool in_ranges(const vec<Range>& ranges, u64 value)
+{
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), value,
+                               [](u64 v, const Range& range)
+    {
+        return v < range.start;
+    });
+
+    return (it != ranges.begin()) and (value < (it - 1)->end);
+}
+
+/**
+* true if location comes from a seed: undo the maps from the last one,
+* following every preimage
+*/
+bool is_seed_location(const vec<Inverse_Map>& inverse, const vec<Range>& seeds,
+                      u64 value, u64 maps_left)
+{
+    if (maps_left == 0)
+        return in_ranges(seeds, value);
+
+    return inverse[maps_left - 1].any_preimage(value, [&](u64 prev)
+    {
+        return is_seed_location(inverse, seeds, prev, maps_left - 1);
+    });
+}
+
+/**
+* Part 2 searching backwards: locations are tried upward from 0 until one
+* leads back into a seed range. Threads pull chunks of the location space
+* in increasing order; once a location is found no thread starts a chunk
+* above it, and the ones still running stop at the first hit of their own.
+*/
+u64 lowest_location_reverse(const Almanac& almanac, u32 num_threads)
+{
+    auto seeds = seed_ranges(almanac);
+    if (seeds.empty())
+        return std::numeric_limits<u64>::max();
+
+    vec<Inverse_Map> inverse;
+    for (const Map& map : almanac.maps)
+    {
+        inverse.push_back(invert(map));
+    }
+
+    constexpr u64 CHUNK = 1 << 16;
+
+    std::atomic<u64> next {0};
+    std::atomic<u64> best {std::numeric_limits<u64>::max()};
+
+    {
+        vec<std::jthread> threads;
+
+        for (u32 t = 0;
+             t < std::max(1u, num_threads);
+             ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                for (u64 begin = next.fetch_add(CHUNK);
+                     begin < best.load();
+                     begin = next.fetch_add(CHUNK))
+                {
+                    auto end = std::min(best.load(), begin + CHUNK);
+
+                    for (u64 location = begin; location < end; ++location)
+                    {
+                        if (is_seed_location(inverse, seeds, location, inverse.size()))
+                        {
+                            // keep the smallest one, another thread may have found a lower one
+                            auto curr = best.load();
+                            while (location < curr and not best.compare_exchange_weak(curr, location))
+                            {
+                            }
+
+                            break;
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    return best.load();
+}
+
+Almanac generate_almanac(std::mt19937_64& rng, u64 space, u64 max_seed_len)
+{
+    auto pick = [&rng](u64 lo, u64 hi)
+    {
+        return std::uniform_int_distribution<u64> {lo, hi}(rng);
+    };
+
+    Almanac almanac;
+
+    for (u32 i = pick(1, 5); i > 0; --i)
+    {
+        almanac.seeds.push_back(pick(0, space));
+        almanac.seeds.push_back(pick(0, max_seed_len));
+    }
+
+    for (u32 m = 0; m < 7; ++m)
+    {
+        Map map;
+        map.name = std::format("map-{}", m);
+
+        // non overlapping sources, any destination
+        for (u64 src = pick(0, space / 8);
+             src < space;
+             src += pick(0, space / 8))
+        {
+            auto len = pick(1, space / 8);
+            map.mappings.insert(Conversion_Table {pick(0, space), src, len});
+            src += len;
+        }
+
+        almanac.maps.push_back(std::move(map));
+    }
+
+    return almanac;
+}
+
+/**
+* almanac where every map shuffles pieces of [0, space) around,
+* like the puzzle input does
+*/
+Almanac generate_shuffled_almanac(std::mt19937_64& rng, u64 space, u32 pieces, u64 seed_len)
+{
+    auto pick = [&rng](u64 lo, u64 hi)
+    {
+        return std::uniform_int_distribution<u64> {lo, hi}(rng);
+    };
+
+    Almanac almanac;
+
+    for (u32 i = 0; i < 10; ++i)
+    {
+        almanac.seeds.push_back(pick(0, space - seed_len));
+        almanac.seeds.push_back(seed_len);
+    }
+
+    for (u32 m = 0; m < 7; ++m)
+    {
+        vec<u64> cuts {0, space};
+        for (u32 i = 1; i < pieces; ++i)
+        {
+            cuts.push_back(pick(1, space - 1));
+        }
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+        vec<u64> lens;
+        for (u64 i = 0; i + 1 < cuts.size(); ++i)
+        {
+            lens.push_back(cuts[i + 1] - cuts[i]);
+        }
+
+        vec<u64> order(lens.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), rng);
+
+        Map map;
+        map.name = std::format("map-{}", m);
+
+        u64 dest = 0;
+        for (auto i : order)
+        {
+            map.mappings.insert(Conversion_Table {dest, cuts[i], lens[i]});
+            dest += lens[i];
+        }
+
+        almanac.maps.push_back(std::move(map));
+    }
+
+    return almanac;
+}
+
+/**
+* times the reverse search against the forward strategies
+*/
+void benchmark_reverse(u32 rounds)
+{
+    using clock = std::chrono::steady_clock;
+    auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::mt19937_64 rng {1205};
+    auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (u32 i = 0;
+         i < rounds;
+         ++i)
+    {
+        auto almanac = generate_shuffled_almanac(rng, 4'000'000'000, 30, 20'000'000);
+
+        auto t0 = clock::now();
+        auto reverse = lowest_location_reverse(almanac, num_threads);
+        auto t1 = clock::now();
+        auto intervals = lowest_location(almanac);
+        auto t2 = clock::now();
+        auto brute = lowest_location_brute_force(almanac, num_threads);
+        auto t3 = clock::now();
+
+        cout << std::format("#{} location {}: reverse {:.1f} ms, intervals {:.3f} ms, forward brute force {:.1f} ms{}",
+                            i, intervals, ms(t1 - t0), ms(t2 - t1), ms(t3 - t2),
+                            (reverse == intervals and brute == intervals) ? "" : " MISMATCH") << endl;
+    }
+}
+
+/**
+* compares the interval engine with the brute force on generated almanacs
+*/
+void verify(u32 rounds)
+{
+    std::mt19937_64 rng {2023};
+
+    for (u32 i = 0;
+         i < rounds;
+         ++i)
+    {
+        auto almanac = generate_almanac(rng, 1'000 * (1 + i % 10), 200);
+
+        auto expected = lowest_location_brute_force(almanac, 1 + i % 4);
+        auto actual = lowest_location(almanac);
+        auto reverse = lowest_location_reverse(almanac, 1 + i % 4);
+
+        if (expected != actual or expected != reverse)
+            throw std::format("almanac #{}: brute force {} intervals {} reverse {}", i, expected, actual, reverse);
+
+        auto f = compose_almanac(almanac);
+        auto sorted = flatten(almanac, Layout::Sorted);
+        auto eytz = flatten(almanac, Layout::Eytzinger);
+
+        for (u64 seed = 0; seed < 2'000 * (1 + i % 10); seed += 1 + i % 7)
+        {
+            auto location = map_seed(sorted, seed);
+
+            if (f(seed) != location or map_seed(eytz, seed) != location)
+                throw std::format("almanac #{}: seed {} maps to {}, eytzinger says {}, composed function says {}",
+                                  i, seed, location, map_seed(eytz, seed), f(seed));
+        }
+
+        // random updates, the service must agree with a fresh interval engine
+        Almanac_Service service {almanac};
+        auto space = 1'000 * (1 + i % 10);
+
+        for (u32 step = 0; step < 20; ++step)
+        {
+            auto pick = [&rng](u64 hi) { return std::uniform_int_distribution<u64> {0, hi}(rng); };
+            const auto& map = almanac.maps[pick(almanac.maps.size() - 1)];
+
+            switch (pick(3))
+            {
+                case 0:
+                    service.add_conversion(map.name, Conversion_Table {pick(space), pick(space), 1 + pick(space / 8)});
+                    break;
+                case 1:
+                    if (not map.mappings.empty())
+                        service.remove_conversion(map.name, std::next(map.mappings.begin(), pick(map.mappings.size() - 1))->src);
+                    break;
+                case 2:
+                {
+                    auto start = pick(space);
+                    service.add_seeds({start, start + 1 + pick(200)});
+                    break;
+                }
+                case 3:
+                {
+                    auto start = pick(space);
+                    service.remove_seeds({start, start + 1 + pick(200)});
+                    break;
+                }
+            }
+
+            almanac = service.almanac();
+
+            if (service.lowest_location() != lowest_location(almanac))
+                throw std::format("almanac #{} step {}: service {} intervals {}",
+                                  i, step, service.lowest_location(), lowest_location(almanac));
+        }
+    }
+
+    cout << "verify: " << rounds << " almanacs OK" << endl;
+}
+
+/**
+* runs the brute force on the real input and checks it against the interval engine
+*/
+void brute_force(const char* file_path)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto almanac = read_almanac(file_path);
+
+    auto t0 = clock::now();
+    auto expected = lowest_location_brute_force(almanac, std::thread::hardware_concurrency());
+    auto t1 = clock::now();
+    auto actual = lowest_location(almanac);
+
+    u64 num_seeds = 0;
+    for (u64 i = 1; i < almanac.seeds.size(); i += 2)
+    {
+        num_seeds += almanac.seeds[i];
+    }
+
+    auto secs = std::chrono::duration<double>(t1 - t0).count();
+
+    cout << std::format("brute force {} ({} seeds in {:.2f} s, {:.0f} M seeds/s), intervals {}: {}",
+                        expected, num_seeds, secs, num_seeds / secs / 1e6, actual,
+                        (expected == actual) ? "OK" : "MISMATCH") << endl;
+}
+
+void part1()
+{
+    auto file_path = "res\\input.txt";
+    auto almanac = read_almanac(file_path);
+    auto f = compose_almanac(almanac);
+
+    // threads only pay off for large batches of seeds
+    constexpr u64 PARALLEL_SEEDS = 1 << 16;
+    auto num_threads = (almanac.seeds.size() >= PARALLEL_SEEDS) ? std::thread::hardware_concurrency() : 1;
+
+    auto locations = map_seeds(f, almanac.seeds, num_threads);
+    u64 res = locations.empty() ? std::numeric_limits<u64>::max() : std::ranges::min(locations);
+
+    cout << "part 1 (" << file_path << ") " << res << endl;
+}
+
+void part2()
+{
+    auto file_path = "res\\input.txt";
+    auto almanac = read_almanac(file_path);
+
+    u64 res = lowest_location(almanac);
+
+    cout << "part 2 (" << file_path << ") " << res << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+
+    try
+    {
+        // "day05 verify [rounds]" checks the interval engine against the brute force
+        if (argc > 1 and argv[1] == "verify"sv)
+        {
+            verify((argc > 2) ? std::stoi(argv[2]) : 1'000);
+            return 0;
+        }
+
+        // "day05 reverse [rounds]" compares the reverse search with the forward one
+        if (argc > 1 and argv[1] == "reverse"sv)
+        {
+            benchmark_reverse((argc > 2) ? std::stoi(argv[2]) : 3);
+            return 0;
+        }
+
+        // "day05 brute" runs the brute force on the real input
+        if (argc > 1 and argv[1] == "brute"sv)
+        {
+            brute_force("res\\input.txt");
+            return 0;
+        }
+
         part1();
         part2();
     }
@@ -2,7 +2,10 @@
 
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: https://pvs-studio.com
 
+#include <algorithm>
 #include <assert.h>
+#include <bit>
+#include <chrono>
 #include <array>
 #include <cstdint>
 #include <exception>
@@ -13,12 +16,15 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <queue>
+#include <random>
 #include <ranges>
 #include <regex>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 using u8 = uint8_t;
@@ -149,95 +155,327 @@ static inline bool is_between(T num, T min, T max)
 struct Hand
 {
     vec<char> original_cards;
-    vec<char> mod_cards;
     u32 bid {};
     u32 score {};
+    u32 key {};
 };
 
+constexpr u8 INVALID_CARD = 0xFF;
+
+/**
+* index of a card, from '2' (0) to 'A' (12), INVALID_CARD for anything else
+*/
+constexpr auto CARD_INDEX = []()
+{
+    std::array<u8, 256> table {};
+    table.fill(INVALID_CARD);
+
+    constexpr auto cards = "23456789TJQKA"sv;
+    for (u8 i = 0; i < cards.size(); ++i)
+    {
+        table[static_cast<u8>(cards[i])] = i;
+    }
+
+    return table;
+}();
+
+/**
+* strength of a card, 1 to 13. With jokers J is the weakest card (0)
+*/
+u32 card_strength(char card, bool jokers)
+{
+    auto index = CARD_INDEX[static_cast<u8>(card)];
+
+    if (index == INVALID_CARD)
+        throw std::format("Unknown card <{}>", card);
+
+    if (jokers and card == 'J')
+        return 0;
+
+    return index + 1;
+}
+
 /**
-* calculate how many A, K, Q, J, etc you have in a single hand
+* how many of each card in the hand, indexed by CARD_INDEX
 */
-map<char, u32> fill_freq_map(const vec<char>& hand)
+std::array<u8, 13> card_histogram(const vec<char>& hand)
 {
-    map<char, u32> freq_map;
+    if (hand.size() != 5)
+        throw std::format("Expected five cards, got <{}>", str {hand.begin(), hand.end()});
+
+    std::array<u8, 13> hist {};
+
     for (char card : hand)
     {
-        freq_map[card] += 1;
+        auto index = CARD_INDEX[static_cast<u8>(card)];
+
+        if (index == INVALID_CARD)
+            throw std::format("Unknown card <{}>", card);
+
+        ++hist[index];
     }
 
-    return freq_map;
+    return hist;
 }
 
 /**
-* calculates how many High card, One pair, Two pair, etc you have in single hand
+* The score of a hand only depends on the sorted pattern of its card
+* counts, and the number of pairs of equal cards (count * (count - 1) / 2
+* summed over the counts) is different for every pattern, so it works as
+* a perfect hash of the pattern:
+*
+*   5 -> 10, 4 1 -> 6, 3 2 -> 4, 3 1 1 -> 3, 2 2 1 -> 2, 2 1 1 1 -> 1, 1 1 1 1 1 -> 0
 */
-std::array<u32, 6> fill_occurr_map(const vec<char>& hand)
+constexpr std::array<u8, 11> SCORE_BY_PAIRS {1, 2, 3, 4, 5, 0, 6, 0, 0, 0, 7};
+
+u32 calculate_hand_score(const vec<char>& hand)
 {
-    auto freq_map = fill_freq_map(hand);
+    auto hist = card_histogram(hand);
 
-    std::array<u32, 6> occurr_map {};
-    for (const auto& [key, value] : freq_map)
+    u32 pairs = 0;
+    for (u32 count : hist)
     {
-        occurr_map.at(value) += 1;
+        pairs += count * (count - 1) / 2;
     }
 
-    return occurr_map;
+    return SCORE_BY_PAIRS[pairs];
 }
 
-auto calculate_hand_score(const vec<char>& hand) -> u32
+/**
+* calculate_hand_score for a batch of valid hands. The cards are stored by
+* column, cards[k * num_hands + h] is card k of hand h: the pairs of equal
+* cards are then the ten compares between columns, the same for every
+* hand, and the loop over the hands vectorizes.
+*/
+void calculate_hand_scores(const vec<char>& cards, u64 num_hands, vec<u8>& scores)
 {
-    auto occurr_map = fill_occurr_map(hand);
+    scores.resize(num_hands);
+
+    const char* c0 = cards.data();
+    const char* c1 = c0 + num_hands;
+    const char* c2 = c1 + num_hands;
+    const char* c3 = c2 + num_hands;
+    const char* c4 = c3 + num_hands;
 
-    u32 score = 0;
+    for (u64 h = 0; h < num_hands; ++h)
+    {
+        scores[h] = static_cast<u8>(
+            (c0[h] == c1[h]) + (c0[h] == c2[h]) + (c0[h] == c3[h]) + (c0[h] == c4[h]) +
+            (c1[h] == c2[h]) + (c1[h] == c3[h]) + (c1[h] == c4[h]) +
+            (c2[h] == c3[h]) + (c2[h] == c4[h]) +
+            (c3[h] == c4[h]));
+    }
 
-    if (occurr_map.at(5) != 0)
+    for (auto& score : scores)
     {
-        // five of a kind
-        score = 7;
+        score = SCORE_BY_PAIRS[score];
     }
-    else if (occurr_map.at(4) != 0)
+}
+
+/**
+* Hand packed in a single integer that sorts like the hand:
+* score in bits 20-23, then the strength of the five cards,
+* 4 bits each, first card in the highest nibble.
+*/
+u32 hand_key(u32 score, const vec<char>& cards, bool jokers)
+{
+    u32 key = score;
+
+    for (char card : cards)
     {
-        // four of a kind
-        score = 6;
+        key = (key << 4) | card_strength(card, jokers);
     }
-    else if (occurr_map.at(3) != 0)
+
+    return key;
+}
+
+/**
+* Runs fn(t, begin, end) on num_threads threads, each one with its own
+* contiguous slice of [0, size)
+*/
+template<typename Fn>
+void for_each_slice(u64 size, u32 num_threads, Fn&& fn)
+{
+    auto slice = (size + num_threads - 1) / num_threads;
+
+    vec<std::jthread> threads;
+
+    for (u32 t = 0;
+         t < num_threads;
+         ++t)
     {
-        if (occurr_map.at(2) == 1)
+        auto begin = std::min(size, t * slice);
+        auto end = std::min(size, begin + slice);
+
+        threads.emplace_back([&fn, t, begin, end]()
         {
-            // full house
-            score = 5;
-        }
-        else if (occurr_map.at(1) == 2)
+            fn(t, begin, end);
+        });
+    }
+}
+
+/**
+* (hand key, bid) pair in a single u64, the key in the high half
+*/
+u64 pack(u32 key, u32 bid)
+{
+    return (static_cast<u64>(key) << 32) | bid;
+}
+
+/**
+* LSD radix sort of packed (key, bid) pairs on the 24 bits of the key,
+* 8 bits per pass. In every pass each thread builds the histogram of its
+* own slice; the per thread offsets are laid out bucket by bucket so the
+* scatter keeps the order of the previous pass (the sort is stable).
+*/
+void radix_sort(vec<u64>& items, u32 num_threads)
+{
+    constexpr u32 RADIX_BITS = 8;
+    constexpr u32 BUCKETS = 1 << RADIX_BITS;
+    constexpr u32 KEY_BITS = 24;
+
+    num_threads = std::clamp<u32>(num_threads, 1, std::max<u64>(1, items.size() / 65536));
+
+    vec<u64> tmp(items.size());
+    vec<std::array<u64, BUCKETS>> offsets(num_threads);
+
+    for (u32 shift = 32;
+         shift < 32 + KEY_BITS;
+         shift += RADIX_BITS)
+    {
+        for_each_slice(items.size(), num_threads, [&](u32 t, u64 begin, u64 end)
         {
-            // three of a kind
-            score = 4;
-        }
-        else
+            auto& hist = offsets[t];
+            hist.fill(0);
+
+            for (u64 i = begin; i < end; ++i)
+            {
+                ++hist[(items[i] >> shift) & (BUCKETS - 1)];
+            }
+        });
+
+        u64 pos = 0;
+        for (u32 b = 0; b < BUCKETS; ++b)
         {
-            throw std::format("WTF?!? <{}>", str {hand.begin(), hand.end()});
+            for (u32 t = 0; t < num_threads; ++t)
+            {
+                auto count = offsets[t][b];
+                offsets[t][b] = pos;
+                pos += count;
+            }
         }
+
+        for_each_slice(items.size(), num_threads, [&](u32 t, u64 begin, u64 end)
+        {
+            auto& next = offsets[t];
+
+            for (u64 i = begin; i < end; ++i)
+            {
+                tmp[next[(items[i] >> shift) & (BUCKETS - 1)]++] = items[i];
+            }
+        });
+
+        std::swap(items, tmp);
     }
-    else if (occurr_map.at(2) == 2)
-    {
-        // two pair
-        score = 3;
-    }
-    else if (occurr_map.at(2) == 1)
+}
+
+/**
+* sum of bid * rank over sorted pairs, each thread sums its own slice
+*/
+u64 sum_winnings(const vec<u64>& sorted, u32 num_threads)
+{
+    num_threads = std::clamp<u32>(num_threads, 1, std::max<u64>(1, sorted.size() / 65536));
+
+    vec<u64> partial(num_threads, 0);
+
+    for_each_slice(sorted.size(), num_threads, [&](u32 t, u64 begin, u64 end)
     {
-        // one pair
-        score = 2;
-    }
-    else if (occurr_map.at(1) == 5)
+        u64 acc = 0;
+
+        // plain loop over contiguous data, left for the compiler to vectorize
+        for (u64 i = begin; i < end; ++i)
+        {
+            acc += (sorted[i] & 0xFFFF'FFFF) * (i + 1);
+        }
+
+        partial[t] = acc;
+    });
+
+    return std::accumulate(partial.begin(), partial.end(), u64 {0});
+}
+
+u64 total_winnings(const vec<Hand>& hands)
+{
+    vec<u64> items;
+    items.reserve(hands.size());
+
+    for (const auto& hand : hands)
     {
-        // high card
-        score = 1;
+        items.push_back(pack(hand.key, hand.bid));
     }
-    else
+
+    auto num_threads = std::thread::hardware_concurrency();
+
+    radix_sort(items, num_threads);
+
+    return sum_winnings(items, num_threads);
+}
+
+/**
+* radix engine against std::sort on random hands
+*/
+void benchmark(const vec<u64>& sizes)
+{
+    using clock = std::chrono::steady_clock;
+    auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::mt19937_64 rng {7};
+    constexpr auto cards = "23456789TJQKA"sv;
+    auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (auto size : sizes)
     {
-        throw std::format("Unknown score for hand <{}>", str {hand.begin(), hand.end()});
-    }
+        vec<char> columns(5 * size);
+        for (auto& card : columns)
+        {
+            card = cards[rng() % cards.size()];
+        }
+
+        vec<u8> scores;
+        calculate_hand_scores(columns, size, scores);
+
+        vec<u64> items(size);
+        for (u64 h = 0; h < size; ++h)
+        {
+            u32 key = scores[h];
+            for (u64 k = 0; k < 5; ++k)
+            {
+                key = (key << 4) | (CARD_INDEX[static_cast<u8>(columns[k * size + h])] + 1);
+            }
+
+            items[h] = pack(key, rng() % 1000 + 1);
+        }
 
-    return score;
+        auto by_sort = items;
+        auto by_radix = items;
+
+        auto t0 = clock::now();
+        std::sort(by_sort.begin(), by_sort.end(), [](u64 lhs, u64 rhs)
+        {
+            return (lhs >> 32) < (rhs >> 32);
+        });
+        auto t1 = clock::now();
+        radix_sort(by_radix, num_threads);
+        auto t2 = clock::now();
+
+        // random hands repeat, so only the keys have to come out in the same order
+        auto key = [](u64 item) { return item >> 32; };
+        bool same = std::ranges::equal(by_sort, by_radix, {}, key, key);
+
+        cout << std::format("{} hands: std::sort {:.1f} ms, radix sort ({} threads) {:.1f} ms{}",
+                            size, ms(t1 - t0), num_threads, ms(t2 - t1),
+                            same ? "" : " MISMATCH") << endl;
+    }
 }
 
 void part1()
@@ -257,313 +495,335 @@ void part1()
         auto bid = static_cast<u32>(std::stoul(parts[1]));
         auto score = calculate_hand_score(cards);
 
-        hands.emplace_back(cards, vec<char>{}, bid, score);
+        auto key = hand_key(score, cards, false);
+
+        hands.emplace_back(cards, bid, score, key);
     }
 
-    std::sort(hands.begin(), hands.end(),
-              [](const Hand& lhs, const Hand& rhs)
-    {
-        return lhs.score > rhs.score;
-    });
+    u64 res = total_winnings(hands);
 
-    std::sort(hands.begin(), hands.end(),
-              [](const Hand& lhs, const Hand& rhs)
-    {
-        static map<char, u32> scoring_map {
-            {'A',13},{'K',12},{'Q',11},
-            {'J',10},{'T',9},{'9',8},
-            {'8',7},{'7',6},{'6',5},
-            {'5',4},{'4',3},{'3',2},
-            {'2',1}
-        };
+    cout << "part 1 (" << file_path << ") " << res << endl;
+}
 
-        if (lhs.score == rhs.score)
-        {
-            for (u32 i = 0;
-                 i < lhs.original_cards.size();
-                 ++i)
-            {
-                auto lhs_score = scoring_map.at(lhs.original_cards.at(i));
-                auto rhs_score = scoring_map.at(rhs.original_cards.at(i));
+/**
+* score of a hand from its two largest card counts
+*/
+constexpr u32 score_from_counts(u32 first, u32 second)
+{
+    if (first == 5) return 7;                   // five of a kind
+    if (first == 4) return 6;                   // four of a kind
+    if (first == 3) return second == 2 ? 5 : 4; // full house or three of a kind
+    if (first == 2) return second == 2 ? 3 : 2; // two pair or one pair
+    return 1;                                   // high card
+}
 
-                if (lhs_score != rhs_score)
-                    return lhs_score < rhs_score;
-            }
+/**
+* The best use of the jokers is always to join the largest group of
+* the other cards, so the score only depends on the joker count and on
+* the two largest counts of the other cards:
+* JOKER_UPGRADE[jokers][first][second] is the score of the hand.
+*/
+constexpr auto JOKER_UPGRADE = []()
+{
+    std::array<std::array<std::array<u8, 6>, 6>, 6> table {};
 
-            throw "you are not supposed to be here...";
-        }
-        else
+    for (u32 jokers = 0; jokers <= 5; ++jokers)
+    {
+        for (u32 first = 0; first + jokers <= 5; ++first)
         {
-            return lhs.score < rhs.score;
+            for (u32 second = 0; second <= first and first + second + jokers <= 5; ++second)
+            {
+                table[jokers][first][second] = static_cast<u8>(score_from_counts(first + jokers, second));
+            }
         }
-    });
+    }
+
+    return table;
+}();
+
+static_assert(JOKER_UPGRADE[5][0][0] == 7); // JJJJJ
+static_assert(JOKER_UPGRADE[1][2][2] == 5); // JKKQQ
+static_assert(JOKER_UPGRADE[2][1][1] == 4); // JJ234
+
+u32 joker_score(const vec<char>& hand)
+{
+    constexpr u32 JOKER = 9; // CARD_INDEX['J']
 
-    u64 res = 0;
+    auto hist = card_histogram(hand);
 
-    for (u64 i = 0;
-         i < hands.size();
-         ++i)
+    u32 jokers = hist[JOKER];
+    hist[JOKER] = 0;
+
+    // two largest counts, without branches
+    u32 first = 0;
+    u32 second = 0;
+
+    for (u32 count : hist)
     {
-        res += hands.at(i).bid * (i + 1);
+        second = std::max(second, std::min(first, count));
+        first = std::max(first, count);
     }
 
-    cout << "part 1 (" << file_path << ") " << res << endl;
+    return JOKER_UPGRADE[jokers][first][second];
 }
 
-vec<char> replace_J_in_hand(const vec<char>& hand)
+void part2()
 {
-    auto find_replacement_card = [](auto freq_map, u32 num) -> char
+    auto file_path = "res\\input.txt";
+    auto ifs = std::ifstream(file_path);
+
+    vec<Hand> hands;
+
+    for (str line;
+         std::getline(ifs, line);
+         )
     {
-        char replacement_card {};
+        auto parts = split_string(line, ' ');
 
-        for (const auto& [key, value] : freq_map)
-        {
-            if (value == num)
-            {
-                replacement_card = key;
-                break;
-            }
-        }
+        auto cards = vec<char>(parts[0].begin(), parts[0].end());
+
+        auto bid = std::stoul(parts[1]);
+        auto mod_score = joker_score(cards);
 
-        return replacement_card;
-    };
+        auto key = hand_key(mod_score, cards, true);
 
-    auto mod_hand = vec<char> {hand};
+        hands.emplace_back(cards, bid, mod_score, key);
+    }
+
+    u64 res = total_winnings(hands);
+
+    cout << "part 2 (" << file_path << ") " << res << endl;
+}
 
-    auto num_of_J = std::count(hand.begin(), hand.end(), 'J');
 
-    auto freq_map = fill_freq_map(hand);
-    freq_map.erase('J');
+/**
+* Order statistics over a growing set of hands, for either part: rank of a
+* hand, k-th hand, strongest hands and the running total winnings, each in
+* O(log n). Two Fenwick trees over the whole key space count the hands and
+* sum their bids per key.
+*
+* A key is mapped to a dense index by reading its score and card nibbles as
+* base 14 digits, 7 * 14^5 slots in all. Equal hands rank in insertion order.
+*/
+struct Hand_Ranking
+{
+    static constexpr u32 BASE = 14;
+    static constexpr u32 KEY_SPACE = 7 * BASE * BASE * BASE * BASE * BASE;
 
-    auto occurr_map = fill_occurr_map(hand);
+    explicit Hand_Ranking(bool jokers)
+        : jokers {jokers}
+        , counts(KEY_SPACE + 1, 0)
+        , bids(KEY_SPACE + 1, 0)
+    {
+    }
 
-    char replacement_card {};
+    void insert(const vec<char>& cards, u32 bid)
+    {
+        auto score = jokers ? joker_score(cards) : calculate_hand_score(cards);
+        insert(hand_key(score, cards, jokers), bid);
+    }
 
-    if (num_of_J == 5)
+    void insert(u32 key, u32 bid)
     {
-        replacement_card = 'A';
+        auto index = index_of(key);
+
+        // the new hand goes after the equal ones already in,
+        // and every stronger hand moves one rank up
+        u64 rank = prefix(counts, index + 1) + 1;
+        winnings += bid * rank + (bid_total - prefix(bids, index + 1));
+
+        add(counts, index, 1);
+        add(bids, index, bid);
+
+        ++num_hands;
+        bid_total += bid;
     }
-    else if (num_of_J == 0)
+
+    // rank the first hand with this key has, or would have
+    u64 rank_of(u32 key) const
     {
-        // nothing to do
-        return mod_hand;
+        return prefix(counts, index_of(key)) + 1;
     }
-    else
+
+    // key of the hand at rank k, 1 <= k <= size()
+    u32 kth(u64 k) const
     {
-        for (u64 i = 5 - num_of_J;
-             i >= 1;
-             --i)
+        if (k == 0 or k > num_hands)
+            throw std::format("No hand at rank {} of {}", k, num_hands);
+
+        u64 pos = 0;
+
+        for (u64 step = std::bit_floor(u64 {KEY_SPACE}); step > 0; step /= 2)
         {
-            if (occurr_map.at(i) != 0)
+            if (pos + step <= KEY_SPACE and counts[pos + step] < k)
             {
-                replacement_card = find_replacement_card(freq_map, i);
-                break;
+                pos += step;
+                k -= counts[pos];
             }
         }
+
+        return key_of(static_cast<u32>(pos));
     }
 
+    // keys of the k strongest hands, strongest first
+    vec<u32> top(u64 k) const
+    {
+        vec<u32> res;
 
-#if 0
-    // the long version:
+        for (u64 rank = num_hands; rank > 0 and res.size() < k; --rank)
+        {
+            res.push_back(kth(rank));
+        }
+
+        return res;
+    }
 
-    if (num_of_J == 5)
+    u64 total_winnings() const
     {
-        // JJJJJ
-        replacement_card = 'A';
+        return winnings;
     }
-    else if (num_of_J == 4)
+
+    u64 size() const
     {
-        // JJJJ1
-        replacement_card = find_replacement_card(freq_map, 1);
+        return num_hands;
     }
-    else if (num_of_J == 3)
+
+    str cards_of(u32 key) const
     {
-        // could be: JJJ22
-        if (occurr_map.at(2) == 1)
-        {
-            replacement_card = find_replacement_card(freq_map, 2);
-        }
-        // could be: JJJ12
-        else if (occurr_map.at(1) == 2)
-        {
-            replacement_card = find_replacement_card(freq_map, 1);
-        }
-        else
+        constexpr auto cards = "?23456789TJQKA"sv;
+
+        str res(5, '?');
+        for (u32 i = 0; i < 5; ++i)
         {
-            throw "Something went wrong, sorry bro... 1";
+            auto strength = (key >> (4 * (4 - i))) & 0xF;
+            res[i] = (jokers and strength == 0) ? 'J' : cards[strength];
         }
 
-        int s = 0;
+        return res;
     }
-    else if (num_of_J == 2)
+
+private:
+
+    bool jokers;
+
+    vec<u32> counts;
+    vec<u64> bids;
+
+    u64 num_hands {0};
+    u64 bid_total {0};
+    u64 winnings {0};
+
+    static u32 index_of(u32 key)
     {
+        u32 index = (key >> 20) - 1;
 
-        // could be: JJ111 -> 11111
-        if (occurr_map.at(3) == 1)
+        for (i32 i = 4; i >= 0; --i)
         {
-            replacement_card = find_replacement_card(freq_map, 3);
-        }
-        // could be: JJ112 -> 11112
-        else if (occurr_map.at(2) == 1)
-        {
-            replacement_card = find_replacement_card(freq_map, 2);
-        }
-        // could be: JJ123 -> 11123
-        else if (occurr_map.at(1) == 3)
-        {
-            replacement_card = find_replacement_card(freq_map, 1);
-        }
-        else
-        {
-            throw "No bueno you miss a case... 2";
+            index = index * BASE + ((key >> (4 * i)) & 0xF);
         }
 
-        int s = 0;
+        return index;
     }
-    else if (num_of_J == 1)
+
+    static u32 key_of(u32 index)
     {
-        // could be: JAAAA
-        if (occurr_map.at(4) == 1)
-        {
-            replacement_card = find_replacement_card(freq_map, 4);
-        }
-        // could be: JQAAA
-        else if (occurr_map.at(3) == 1)
-        {
-            replacement_card = find_replacement_card(freq_map, 3);
-        }
-        // could be: JAAQQ
-        else if (occurr_map.at(2) == 2)
-        {
-            replacement_card = find_replacement_card(freq_map, 2);
-        }
-        // could be: JAA12
-        else if (occurr_map.at(2) == 1)
-        {
-            replacement_card = find_replacement_card(freq_map, 2);
-        }
-        // could be: J1234
-        else if (occurr_map.at(1) == 4)
-        {
-            replacement_card = find_replacement_card(freq_map, 1);
-        }
-        else
+        u32 key = 0;
+
+        for (u32 i = 0; i < 5; ++i)
         {
-            throw "No bueno you miss a case... 1";
+            key |= (index % BASE) << (4 * i);
+            index /= BASE;
         }
 
-        int s = 0;
-    }
-    else if (num_of_J == 0)
-    {
-        return mod_hand;
-    }
-    else
-    {
-        throw "BRUUH";
+        return key | ((index + 1) << 20);
     }
 
-#endif // 0
+    // sum of the first n slots
+    template<typename T>
+    static u64 prefix(const vec<T>& tree, u64 n)
+    {
+        u64 res = 0;
 
+        for (; n > 0; n -= n & (~n + 1))
+        {
+            res += tree[n];
+        }
 
-    std::replace_if(mod_hand.begin(), mod_hand.end(),
-                    [](char ch) { return ch == 'J'; },
-                    replacement_card);
+        return res;
+    }
 
-    // sanity check
+    template<typename T>
+    static void add(vec<T>& tree, u64 index, u64 value)
     {
-        auto score_before = calculate_hand_score(hand);
-        auto score_after = calculate_hand_score(mod_hand);
-        if (score_before >= score_after and
-            num_of_J != 5)
+        for (u64 n = index + 1; n <= KEY_SPACE; n += n & (~n + 1))
         {
-            throw std::format("Your algorithm suuuuuuucks: before <{}:{}> after <{}:{}>",
-                              str {hand.begin(), hand.end()}, score_before,
-                              str {mod_hand.begin(), mod_hand.end()}, score_after);
+            tree[n] += static_cast<T>(value);
         }
     }
+};
 
-    return mod_hand;
-
-}
-
-void part2()
+/**
+* Reads hands from is one at a time, keeping the ranking of both parts
+* up to date, then prints the totals and the k strongest hands
+*/
+void stream(std::istream& is, u64 k)
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
-
-    vec<Hand> hands;
+    Hand_Ranking part1 {false};
+    Hand_Ranking part2 {true};
 
     for (str line;
-         std::getline(ifs, line);
+         std::getline(is, line);
          )
     {
         auto parts = split_string(line, ' ');
+        if (parts.size() != 2)
+            continue;
 
         auto cards = vec<char>(parts[0].begin(), parts[0].end());
-        auto mod_cards = replace_J_in_hand(cards);
-
-        auto bid = std::stoul(parts[1]);
-        auto mod_score = calculate_hand_score(mod_cards);
+        auto bid = static_cast<u32>(std::stoul(parts[1]));
 
-        hands.emplace_back(cards, mod_cards, bid, mod_score);
+        part1.insert(cards, bid);
+        part2.insert(cards, bid);
     }
 
-    std::sort(hands.begin(), hands.end(),
-              [](const Hand& lhs, const Hand& rhs)
+    for (const auto* ranking : {&part1, &part2})
     {
-        return lhs.score > rhs.score;
-    });
+        cout << "part " << (ranking == &part1 ? 1 : 2) << " (stdin) " << ranking->total_winnings() << endl;
 
-    std::sort(hands.begin(), hands.end(),
-              [](const Hand& lhs, const Hand& rhs)
-    {
-        static map<char, u32> strength_map {
-            {'A',13},{'K',12},{'Q',11},
-            {'J',0},{'T',9},{'9',8},
-            {'8',7},{'7',6},{'6',5},
-            {'5',4},{'4',3},{'3',2},
-            {'2',1}
-        };
+        for (auto key : ranking->top(k))
+        {
+            cout << "    #" << ranking->rank_of(key) << " " << ranking->cards_of(key) << endl;
+        }
+    }
+}
 
-        if (lhs.score == rhs.score)
+int main(int argc, char* argv[])
+{
+    try
+    {
+        // "day07 bench [hands...]" times the radix engine against std::sort
+        if (argc > 1 and argv[1] == "bench"sv)
         {
-            for (u32 i = 0;
-                 i < lhs.original_cards.size();
-                 ++i)
+            vec<u64> sizes;
+            for (int i = 2; i < argc; ++i)
             {
-                auto lhs_card_strength = strength_map.at(lhs.original_cards.at(i));
-                auto rhs_card_strength = strength_map.at(rhs.original_cards.at(i));
-
-                if (lhs_card_strength != rhs_card_strength)
-                    return lhs_card_strength < rhs_card_strength;
+                sizes.push_back(std::stoull(argv[i]));
             }
 
-            throw "you are not supposed to be here...";
+            if (sizes.empty())
+                sizes = {1'000'000, 10'000'000, 100'000'000};
+
+            benchmark(sizes);
+            return 0;
         }
-        else
+
+        // "day07 - [k]" streams hands from stdin and shows the k strongest
+        if (argc > 1 and argv[1] == "-"sv)
         {
-            return lhs.score < rhs.score;
+            stream(std::cin, (argc > 2) ? std::stoull(argv[2]) : 5);
+            return 0;
         }
-    });
-
-    u64 res = 0;
-    u32 pos = 1;
-
-    std::for_each(hands.begin(), hands.end(),
-                  [&res, &pos](const Hand& hand)
-    {
-        res += hand.bid * pos++;
-    });
-
-    cout << "part 2 (" << file_path << ") " << res << endl;
-}
 
-
-int main()
-{
-    try
-    {
         part1();
         part2();
     }
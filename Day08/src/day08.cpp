@@ -2,8 +2,12 @@
 
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: https://pvs-studio.com
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <assert.h>
+#include <bit>
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <filesystem>
@@ -14,12 +18,17 @@
 #include <limits>
 #include <map>
 #include <numeric>
+#include <optional>
 #include <queue>
+#include <random>
 #include <ranges>
 #include <regex>
 #include <set>
 #include <string_view>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 using u8 = uint8_t;
@@ -147,178 +156,983 @@ static inline bool is_between(T num, T min, T max)
 // ==============================================
 // ==============================================
 
-struct Dir
+// ids fit in a u16, the last value marks "no node"
+constexpr u16 NO_NODE = std::numeric_limits<u16>::max();
+
+/**
+* Interns node names into dense u16 ids in order of first appearance.
+* Three character names of digits and capitals (all the real inputs have)
+* are looked up directly by their base 36 value, anything else goes through
+* a hash map.
+*/
+struct Node_Registry
 {
-    str left;
-    str right;
+    static constexpr u32 BASE = 36;
+    static constexpr u32 SHORT_CODES = BASE * BASE * BASE;
+
+    vec<u16> short_ids = vec<u16>(SHORT_CODES, NO_NODE);
+    std::unordered_map<str, u16> long_ids;
+    vec<str> names;
+
+    static i32 digit(char ch)
+    {
+        if (is_between(ch, '0', '9'))
+            return ch - '0';
+        if (is_between(ch, 'A', 'Z'))
+            return ch - 'A' + 10;
+
+        return -1;
+    }
+
+    // base 36 value of a short name, or -1 when the name doesn't have one
+    static i32 short_code(string_view name)
+    {
+        if (name.size() != 3)
+            return -1;
+
+        i32 code = 0;
+        for (char ch : name)
+        {
+            auto d = digit(ch);
+            if (d < 0)
+                return -1;
+
+            code = code * BASE + d;
+        }
+
+        return code;
+    }
+
+    u16 intern(string_view name)
+    {
+        auto code = short_code(name);
+
+        u16* id = nullptr;
+
+        if (code >= 0)
+        {
+            id = &short_ids[code];
+        }
+        else
+        {
+            auto [it, inserted] = long_ids.try_emplace(str(name), NO_NODE);
+            id = &it->second;
+        }
+
+        if (*id == NO_NODE)
+        {
+            if (names.size() == NO_NODE)
+                throw std::format("Too many nodes, cannot add <{}>", name);
+
+            *id = static_cast<u16>(names.size());
+            names.emplace_back(name);
+        }
+
+        return *id;
+    }
+
+    u16 find(string_view name) const
+    {
+        auto code = short_code(name);
+
+        if (code >= 0)
+            return short_ids[code];
+
+        auto it = long_ids.find(str(name));
+        return (it != long_ids.end()) ? it->second : NO_NODE;
+    }
+
+    u16 size() const
+    {
+        return static_cast<u16>(names.size());
+    }
 };
 
-struct Map
+/**
+* The network with every name replaced by its id. A step from node n with
+* instruction i is next[n][instructions[i]], where left is 0 and right is 1
+*/
+struct Network
 {
-    str instructions;
-    map<str, Dir> nodes;
+    vec<u8> instructions;
+    vec<std::array<u16, 2>> next;
+    Node_Registry nodes;
+
+    // ids of all the nodes whose name ends with ch, as flags
+    vec<u8> ending_with(char ch) const
+    {
+        vec<u8> res(nodes.size(), 0);
+
+        for (u16 id = 0;
+             id < nodes.size();
+             ++id)
+        {
+            res[id] = nodes.names[id].ends_with(ch);
+        }
+
+        return res;
+    }
+
+    u16 id(string_view name) const
+    {
+        auto res = nodes.find(name);
+        if (res == NO_NODE or res >= next.size())
+            throw std::format("Unknown node <{}>", name);
+
+        return res;
+    }
 };
 
-void part1()
+vec<u8> decode_instructions(string_view line)
+{
+    vec<u8> res;
+    res.reserve(line.size());
+
+    for (char dir : line)
+    {
+        if (dir == 'L')
+            res.push_back(0);
+        else if (dir == 'R')
+            res.push_back(1);
+        else
+            throw std::format("Invalid instruction <{}>", dir);
+    }
+
+    if (res.empty())
+        throw "no instructions!";
+
+    return res;
+}
+
+/**
+* Parses the network, every node line looks like "AAA = (BBB, CCC)"
+*/
+Network read_network(const char* file_path)
 {
-    auto file_path = "res\\input.txt";
     auto ifs = std::ifstream(file_path);
     if (not ifs.is_open())
         throw std::format("Cannot open file <{}>", file_path);
 
-    Map map;
+    Network network;
 
     // first line is directions
     str line;
     std::getline(ifs, line);
 
-    map.instructions = line;
-
-    const auto pattern = std::regex(R"((\w{3})\s+=\s+\((\w{3}),\s+(\w{3})\))");
+    network.instructions = decode_instructions(trim(line));
 
     for (;
          std::getline(ifs, line);
          )
     {
-        auto token = line;
+        auto text = string_view {line};
 
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        auto eq = text.find('=');
+        auto open = text.find('(');
+        auto comma = text.find(',');
+        auto close = text.find(')');
+
+        if (eq == string_view::npos)
         {
-            map.nodes[match[1].str()] = Dir {match[2].str(), match[3].str()};
+            if (not trim(line).empty())
+                throw std::format("Invalid node line <{}>", line);
 
-            token = match.suffix();
+            continue;
         }
+
+        if (open == string_view::npos or comma == string_view::npos or close == string_view::npos or
+            not (eq < open and open < comma and comma < close))
+            throw std::format("Invalid node line <{}>", line);
+
+        auto name = trim(str(text.substr(0, eq)));
+        auto left = trim(str(text.substr(open + 1, comma - open - 1)));
+        auto right = trim(str(text.substr(comma + 1, close - comma - 1)));
+
+        auto node = network.nodes.intern(name);
+        auto dirs = std::array<u16, 2> {network.nodes.intern(left), network.nodes.intern(right)};
+
+        if (network.next.size() < network.nodes.size())
+            network.next.resize(network.nodes.size(), {NO_NODE, NO_NODE});
+
+        network.next[node] = dirs;
     }
 
-    str current_node = "AAA";
-    u64 index = 0;
-    u64 steps = 0;
-    auto instructions_size = map.instructions.size();
+    network.next.resize(network.nodes.size(), {NO_NODE, NO_NODE});
 
-    while (current_node != "ZZZ")
+    for (u16 id = 0;
+         id < network.nodes.size();
+         ++id)
     {
-        index = index % instructions_size;
-        char dir = map.instructions.at(index);
+        if (network.next[id][0] == NO_NODE)
+            throw std::format("Node <{}> is never defined", network.nodes.names[id]);
+    }
 
-        //cout << steps << ". " << current_node << " (" << dir << ") ";
+    return network;
+}
 
-        if (dir == 'L')
+// first_hit result for a target that is never reached
+constexpr u64 NO_HIT = std::numeric_limits<u64>::max();
+
+/**
+* Binary lifting over whole passes of the instruction string.
+* levels[j][n] holds the node reached 2^j passes after starting a pass at n,
+* and the first step (1 .. 2^j * pass_len) at which a target node is
+* visited on the way, or NO_HIT. There are enough levels to cover any u64
+* step count.
+*/
+struct Pass_Table
+{
+    struct Jump
+    {
+        u16 node;
+        u64 hit;
+    };
+
+    const Network& network;
+    vec<u8> targets;
+    u64 pass_len;
+    vec<vec<Jump>> levels;
+
+    Pass_Table(const Network& network, vec<u8> targets)
+        : network {network}
+        , targets {std::move(targets)}
+        , pass_len {network.instructions.size()}
+    {
+        auto num_nodes = network.next.size();
+
+        // one pass from every node
+        auto& first = levels.emplace_back(num_nodes);
+
+        for (u16 start = 0;
+             start < num_nodes;
+             ++start)
         {
-            current_node = map.nodes.at(current_node).left;
+            auto node = start;
+            u64 hit = NO_HIT;
+
+            for (u64 i = 0;
+                 i < pass_len;
+                 ++i)
+            {
+                node = network.next[node][network.instructions[i]];
+
+                if (hit == NO_HIT and this->targets[node])
+                    hit = i + 1;
+            }
+
+            first[start] = {node, hit};
         }
-        else if (dir == 'R')
+
+        // 2^j passes are two runs of 2^(j-1), up to the largest level whose
+        // step count still fits a u64
+        auto num_levels = std::bit_width(std::numeric_limits<u64>::max() / pass_len);
+
+        for (u32 j = 1;
+             j < num_levels;
+             ++j)
+        {
+            const auto& prev = levels[j - 1];
+            auto half = (u64 {1} << (j - 1)) * pass_len;
+
+            vec<Jump> next(num_nodes);
+
+            for (u16 n = 0;
+                 n < num_nodes;
+                 ++n)
+            {
+                auto a = prev[n];
+                auto b = prev[a.node];
+
+                next[n].node = b.node;
+                next[n].hit = (a.hit != NO_HIT) ? a.hit : (b.hit != NO_HIT) ? half + b.hit : NO_HIT;
+            }
+
+            levels.push_back(std::move(next));
+        }
+    }
+
+    // node reached k steps after start, beginning at the first instruction
+    u16 position(u16 start, u64 k) const
+    {
+        auto node = start;
+        auto passes = k / pass_len;
+
+        for (u32 j = 0;
+             passes > 0;
+             ++j, passes >>= 1)
         {
-            current_node = map.nodes.at(current_node).right;
+            if (passes & 1)
+                node = levels[j][node].node;
         }
-        else
+
+        for (u64 i = 0;
+             i < k % pass_len;
+             ++i)
         {
-            throw "no bueno!";
+            node = network.next[node][network.instructions[i]];
         }
-        //cout << current_node << endl;
 
-        ++index;
-        ++steps;
+        return node;
     }
 
-    u64 res = steps;
-    cout << "part 1 (" << file_path << ") " << res << endl;
+    // number of steps until start first stands on a target, or NO_HIT
+    u64 first_hit(u16 start) const
+    {
+        if (targets[start])
+            return 0;
+
+        // skip the longest run of passes without a hit, the hit (if any)
+        // is in the pass right after it
+        auto node = start;
+        u64 steps = 0;
+
+        for (auto j = levels.size();
+             j-- > 0;
+             )
+        {
+            const auto& jump = levels[j][node];
+
+            if (jump.hit == NO_HIT)
+            {
+                // the walk is periodic long before this, no hit ever
+                if (steps > NO_HIT - (u64 {1} << j) * pass_len)
+                    return NO_HIT;
+
+                steps += (u64 {1} << j) * pass_len;
+                node = jump.node;
+            }
+        }
+
+        auto hit = levels[0][node].hit;
+        if (hit == NO_HIT or steps > NO_HIT - hit)
+            return NO_HIT;
+
+        return steps + hit;
+    }
+};
+
+/**
+* Brent's cycle detection on x0, f(x0), f(f(x0)), ...
+* returns {mu, lambda}, the sequence repeats with period lambda from index mu on
+*/
+template<typename T, typename F>
+std::pair<u64, u64> find_cycle(T x0, F f)
+{
+    u64 power = 1;
+    u64 lambda = 1;
+
+    auto tortoise = x0;
+    auto hare = f(x0);
+
+    while (tortoise != hare)
+    {
+        if (power == lambda)
+        {
+            tortoise = hare;
+            power *= 2;
+            lambda = 0;
+        }
+
+        hare = f(hare);
+        ++lambda;
+    }
+
+    tortoise = x0;
+    hare = x0;
+
+    for (u64 i = 0;
+         i < lambda;
+         ++i)
+    {
+        hare = f(hare);
+    }
+
+    u64 mu = 0;
+
+    while (tortoise != hare)
+    {
+        tortoise = f(tortoise);
+        hare = f(hare);
+        ++mu;
+    }
+
+    return {mu, lambda};
 }
 
-void part2()
+/**
+* The walk of one ghost over (node, instruction index) states: after tail
+* steps it repeats every length steps. Target hits before that are kept as
+* step counts, the ones on the cycle as offsets from tail, reduced to the
+* smallest period the hits repeat with (which divides length).
+*/
+struct Ghost_Cycle
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
-    if (not ifs.is_open())
-        throw std::format("Cannot open file <{}>", file_path);
+    u64 tail {0};
+    u64 length {0};
+    u64 period {0};
+    vec<u64> tail_hits;
+    vec<u64> cycle_hits;
 
-    Map map;
+    bool hit_at(u64 step) const
+    {
+        if (step < tail)
+            return std::ranges::binary_search(tail_hits, step);
 
-    // first line is directions
-    str line;
-    std::getline(ifs, line);
+        return std::ranges::binary_search(cycle_hits, (step - tail) % period);
+    }
+
+    bool operator==(const Ghost_Cycle&) const = default;
+};
 
-    map.instructions = line;
+/**
+* Finds the cycle of the ghost starting at start. Brent runs over the states
+* at pass boundaries (node, 0), one pass table lookup per state, which gives
+* the period exactly and the tail to within one pass; comparing that last
+* pass with its copy one period later pins the tail down.
+*/
+Ghost_Cycle analyze_ghost(const Pass_Table& table, u16 start)
+{
+    const auto& network = table.network;
+    auto pass_len = table.pass_len;
 
-    const auto pattern = std::regex(R"((\w{3})\s+=\s+\((\w{3}),\s+(\w{3})\))");
+    auto [mu, lambda] = find_cycle(start, [&table](u16 node) { return table.levels[0][node].node; });
 
-    for (;
-         std::getline(ifs, line);
-         )
+    Ghost_Cycle ghost;
+    ghost.length = lambda * pass_len;
+    ghost.tail = mu * pass_len;
+
+    if (mu > 0)
     {
-        auto token = line;
+        auto a = table.position(start, (mu - 1) * pass_len);
+        auto b = table.position(start, (mu - 1 + lambda) * pass_len);
 
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        // the first step of the pass where both walks meet, they agree from then on
+        for (u64 i = 0;
+             a != b;
+             ++i)
         {
-            map.nodes[match[1].str()] = Dir {match[2].str(), match[3].str()};
+            a = network.next[a][network.instructions[i]];
+            b = network.next[b][network.instructions[i]];
 
-            token = match.suffix();
+            ghost.tail = (mu - 1) * pass_len + i + 1;
         }
     }
 
+    auto node = start;
+
+    for (u64 step = 0;
+         step < ghost.tail + ghost.length;
+         ++step)
+    {
+        if (table.targets[node])
+        {
+            if (step < ghost.tail)
+                ghost.tail_hits.push_back(step);
+            else
+                ghost.cycle_hits.push_back(step - ghost.tail);
+        }
+
+        node = network.next[node][network.instructions[step % pass_len]];
+    }
+
+    // smallest divisor of the length the hits are invariant under
+    vec<u64> divisors;
+
+    for (u64 d = 1;
+         d * d <= ghost.length;
+         ++d)
+    {
+        if (ghost.length % d == 0)
+        {
+            divisors.push_back(d);
+            divisors.push_back(ghost.length / d);
+        }
+    }
+
+    std::ranges::sort(divisors);
+
+    auto repeats_every = [&ghost](u64 d)
+    {
+        return std::ranges::all_of(ghost.cycle_hits, [&ghost, d](u64 hit)
+        {
+            return std::ranges::binary_search(ghost.cycle_hits, (hit + d) % ghost.length);
+        });
+    };
+
+    ghost.period = *std::ranges::find_if(divisors, repeats_every);
+
+    std::erase_if(ghost.cycle_hits, [&ghost](u64 hit) { return hit >= ghost.period; });
+
+    return ghost;
+}
+
+// a * b % m without overflow, for m < 2^63
+u64 mul_mod(u64 a, u64 b, u64 m)
+{
+    u64 res = 0;
+    a %= m;
+
+    for (;
+         b > 0;
+         b >>= 1)
+    {
+        if (b & 1)
+            res = (res + a) % m;
+
+        a = (a + a) % m;
+    }
+
+    return res;
+}
 
-    constexpr auto ends_with_a = [](str_cref key)
+// inverse of a modulo m, a and m coprime
+u64 inverse_mod(u64 a, u64 m)
+{
+    i64 old_r = static_cast<i64>(a % m);
+    i64 r = static_cast<i64>(m);
+    i64 old_s = 1;
+    i64 s = 0;
+
+    while (r != 0)
     {
-        return key.ends_with("A");
+        auto q = old_r / r;
+
+        old_r = std::exchange(r, old_r - q * r);
+        old_s = std::exchange(s, old_s - q * s);
+    }
+
+    auto res = old_s % static_cast<i64>(m);
+    return static_cast<u64>(res < 0 ? res + static_cast<i64>(m) : res);
+}
+
+/**
+* Generalized CRT: the x in [0, lcm(m, n)) with x = a mod m and x = b mod n,
+* the moduli don't have to be coprime. Returns nothing if there is no such x.
+*/
+std::optional<u64> crt(u64 a, u64 m, u64 b, u64 n)
+{
+    auto g = std::gcd(m, n);
+
+    if (a % g != b % g)
+        return std::nullopt;
+
+    if (m / g > (std::numeric_limits<u64>::max() >> 1) / n)
+        throw std::format("Combined cycle length of {} and {} does not fit", m, n);
+
+    auto n_g = n / g;
+    auto delta = (b + n - a % n) % n / g;
+    auto k = mul_mod(delta, inverse_mod(m / g, n_g), n_g);
+
+    return a + m * k;
+}
+
+/**
+* First step at which every ghost stands on a target, or NO_HIT.
+* Before all ghosts are on their cycles the steps are checked one hit of
+* the first ghost at a time; after that each ghost allows a few residues
+* modulo its period, and those are merged ghost by ghost with CRT, pairing
+* only the residues that agree modulo the gcd of the periods.
+*/
+u64 ghosts_meet(const vec<Ghost_Cycle>& ghosts)
+{
+    // keeps the merged residue sets from exploding on pathological networks
+    constexpr u64 MAX_RESIDUES = 1 << 20;
+
+    if (ghosts.empty())
+        return 0;
+
+    auto all_hit = [&ghosts](u64 step)
+    {
+        return std::ranges::all_of(ghosts, [step](const Ghost_Cycle& ghost) { return ghost.hit_at(step); });
     };
 
-    auto start_nodes =
-        map.nodes |
-        std::views::keys |
-        std::views::filter(ends_with_a) |
-        std::ranges::to<std::vector>();
+    auto settled = std::ranges::max(ghosts, {}, &Ghost_Cycle::tail).tail;
+    const auto& first = ghosts.front();
+
+    for (auto step : first.tail_hits)
+    {
+        if (all_hit(step))
+            return step;
+    }
 
-    auto inst_size = map.instructions.size();
+    for (u64 base = first.tail;
+         base < settled;
+         base += first.period)
+    {
+        for (auto hit : first.cycle_hits)
+        {
+            if (base + hit < settled and all_hit(base + hit))
+                return base + hit;
+        }
+    }
 
-    vec<u64> cycles;
+    // from here on every ghost is periodic
+    u64 modulus = 1;
+    vec<u64> residues {0};
 
-    for (auto curr_node : start_nodes)
+    for (const auto& ghost : ghosts)
     {
-        u64 index = 0;
-        u64 cycle_len = 0;
+        // a residue r and a hit h are only compatible when they agree modulo the gcd
+        auto g = std::gcd(modulus, ghost.period);
+
+        std::unordered_map<u64, vec<u64>> by_class;
+        for (auto hit : ghost.cycle_hits)
+        {
+            auto h = (ghost.tail + hit) % ghost.period;
+            by_class[h % g].push_back(h);
+        }
+
+        vec<u64> merged;
 
-        while (not curr_node.ends_with("Z"))
+        for (auto r : residues)
         {
-            index = index % inst_size;
-            char dir = map.instructions.at(index);
+            auto it = by_class.find(r % g);
+            if (it == by_class.end())
+                continue;
 
-            if (dir == 'L')
+            for (auto h : it->second)
             {
-                curr_node = map.nodes.at(curr_node).left;
+                merged.push_back(*crt(r, modulus, h, ghost.period));
+
+                if (merged.size() > MAX_RESIDUES)
+                    throw std::format("Too many ways for the ghosts to meet, more than {}", MAX_RESIDUES);
             }
-            else if (dir == 'R')
+        }
+
+        std::ranges::sort(merged);
+        merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+
+        if (merged.empty())
+            return NO_HIT;
+
+        modulus = std::lcm(modulus, ghost.period);
+        residues = std::move(merged);
+    }
+
+    u64 res = NO_HIT;
+
+    for (auto r : residues)
+    {
+        res = std::min(res, settled + (r + modulus - settled % modulus) % modulus);
+    }
+
+    return res;
+}
+
+/**
+* Analyzes the ghosts starting on starts, each ghost is one task for a pool
+* of num_threads workers that take the next unclaimed ghost when done
+*/
+vec<Ghost_Cycle> analyze_ghosts(const Pass_Table& table, const vec<u16>& starts, u32 num_threads)
+{
+    vec<Ghost_Cycle> ghosts(starts.size());
+    if (starts.empty())
+        return ghosts;
+
+    std::atomic<u64> next {0};
+
+    {
+        vec<std::jthread> threads;
+
+        for (u32 t = 0;
+             t < std::clamp<u64>(num_threads, 1, starts.size());
+             ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                for (u64 i = next.fetch_add(1);
+                     i < starts.size();
+                     i = next.fetch_add(1))
+                {
+                    ghosts[i] = analyze_ghost(table, starts[i]);
+                }
+            });
+        }
+    }
+
+    return ghosts;
+}
+
+/**
+* Steps until the ghosts starting on starts all stand on a target at once
+*/
+u64 ghosts_meet(const Pass_Table& table, const vec<u16>& starts, u32 num_threads)
+{
+    return ghosts_meet(analyze_ghosts(table, starts, num_threads));
+}
+
+/**
+* A random network of num_nodes nodes, the node with id i is named after i in
+* base 36, so about one in 36 names ends with 'A' and one in 36 with 'Z'.
+* With bijective set left and right are each a permutation of the nodes,
+* which makes for few and very long cycles.
+*/
+Network generate_network(std::mt19937_64& rng, u32 num_nodes, u32 inst_len, bool bijective = false)
+{
+    if (not is_between<u32>(num_nodes, 1, Node_Registry::SHORT_CODES))
+        throw std::format("Cannot generate a network of {} nodes", num_nodes);
+
+    auto pick = [&rng](u32 hi) { return std::uniform_int_distribution<u32> {0, hi}(rng); };
+
+    constexpr auto digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"sv;
+
+    Network network;
+
+    for (u32 i = 0;
+         i < num_nodes;
+         ++i)
+    {
+        auto name = str {digits[i / (36 * 36)], digits[i / 36 % 36], digits[i % 36]};
+        network.nodes.intern(name);
+        network.next.push_back({static_cast<u16>(pick(num_nodes - 1)), static_cast<u16>(pick(num_nodes - 1))});
+    }
+
+    if (bijective)
+    {
+        for (u32 dir = 0;
+             dir < 2;
+             ++dir)
+        {
+            vec<u16> perm(num_nodes);
+            std::iota(perm.begin(), perm.end(), u16 {0});
+            std::ranges::shuffle(perm, rng);
+
+            for (u32 i = 0;
+                 i < num_nodes;
+                 ++i)
             {
-                curr_node = map.nodes.at(curr_node).right;
+                network.next[i][dir] = perm[i];
             }
-            else
+        }
+    }
+
+    for (u32 i = 0;
+         i < inst_len;
+         ++i)
+    {
+        network.instructions.push_back(static_cast<u8>(pick(1)));
+    }
+
+    return network;
+}
+
+/**
+* Checks the pass table against plain walks on random networks
+*/
+void verify(u32 rounds)
+{
+    std::mt19937_64 rng {808};
+
+    for (u32 i = 0;
+         i < rounds;
+         ++i)
+    {
+        auto num_nodes = 1 + i % 97;
+        auto network = generate_network(rng, num_nodes, 1 + i % 13, i % 5 == 0);
+
+        auto targets = vec<u8>(num_nodes, 0);
+        targets[std::uniform_int_distribution<u32> {0, num_nodes - 1}(rng)] = 1;
+
+        Pass_Table table {network, targets};
+
+        for (u16 start = 0;
+             start < num_nodes;
+             ++start)
+        {
+            // a walk without a hit in num_nodes passes never hits
+            auto limit = u64 {num_nodes} * network.instructions.size();
+            auto node = start;
+            u64 expected = NO_HIT;
+
+            for (u64 step = 0;
+                 step <= limit;
+                 ++step)
             {
-                throw "no bueno!";
+                if (expected == NO_HIT and targets[node])
+                    expected = step;
+
+                if (table.position(start, step) != node)
+                    throw std::format("network #{}: {} steps from {} lands on {}, expected {}",
+                                      i, step, start, table.position(start, step), node);
+
+                node = network.next[node][network.instructions[step % network.instructions.size()]];
             }
 
-            ++index;
-            ++cycle_len;
+            if (table.first_hit(start) != expected)
+                throw std::format("network #{}: first hit from {} is {}, expected {}",
+                                  i, start, table.first_hit(start), expected);
+        }
+
+        // very long walks agree with splitting them in two
+        for (u32 q = 0;
+             q < 10;
+             ++q)
+        {
+            auto k = std::uniform_int_distribution<u64> {0, 1'000'000'000'000}(rng);
+            auto split = k / 2 - k / 2 % network.instructions.size();
+            u16 start = 0;
+
+            if (table.position(start, k) != table.position(table.position(start, split), k - split))
+                throw std::format("network #{}: walk of {} steps differs when split", i, k);
         }
 
-        cycles.push_back(cycle_len);
+        // a few ghosts on random targets, against walking them all in step
+        auto ghost_targets = vec<u8>(num_nodes, 0);
+        for (auto& target : ghost_targets)
+        {
+            target = std::uniform_int_distribution<u32> {0, 2}(rng) == 0;
+        }
+
+        Pass_Table ghost_table {network, ghost_targets};
+
+        vec<u16> starts(1 + i % 4);
+        for (auto& start : starts)
+        {
+            start = static_cast<u16>(std::uniform_int_distribution<u32> {0, num_nodes - 1}(rng));
+        }
+
+        constexpr u64 WALK_LIMIT = 100'000;
+
+        auto nodes = starts;
+        u64 expected = NO_HIT;
+
+        for (u64 step = 0;
+             step < WALK_LIMIT;
+             ++step)
+        {
+            if (std::ranges::all_of(nodes, [&ghost_targets](u16 node) { return ghost_targets[node]; }))
+            {
+                expected = step;
+                break;
+            }
+
+            for (auto& node : nodes)
+            {
+                node = network.next[node][network.instructions[step % network.instructions.size()]];
+            }
+        }
+
+        auto actual = ghosts_meet(ghost_table, starts, 1 + i % 3);
+
+        if (actual != expected and not (expected == NO_HIT and actual >= WALK_LIMIT))
+            throw std::format("network #{}: ghosts meet after {} steps, expected {}", i, actual, expected);
     }
 
-    u64 res = std::accumulate(cycles.begin(), cycles.end(), 1ULL,
-                              [](u64 acc, u64 value)
+    cout << "verify: " << rounds << " networks OK" << endl;
+}
+
+/**
+* Times the ghost analysis on a random network with long cycles and a ghost
+* on every node whose name ends with 'A', sequentially and on all hardware threads
+*/
+void benchmark(u32 num_nodes, u32 inst_len)
+{
+    using clock = std::chrono::steady_clock;
+    auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::mt19937_64 rng {88};
+    auto network = generate_network(rng, num_nodes, inst_len, true);
+    auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto starts = network.ending_with('A');
+
+    vec<u16> start_nodes;
+
+    for (u16 start = 0;
+         start < network.nodes.size();
+         ++start)
     {
-        u64 res = std::lcm(acc, value);
-        return res;
-    });
+        if (starts[start])
+            start_nodes.push_back(start);
+    }
+
+    auto t0 = clock::now();
+    Pass_Table table {network, network.ending_with('Z')};
+    auto t1 = clock::now();
+    auto sequential = analyze_ghosts(table, start_nodes, 1);
+    auto t2 = clock::now();
+    auto parallel = analyze_ghosts(table, start_nodes, num_threads);
+    auto t3 = clock::now();
+
+    cout << std::format("{} nodes, {} instructions, {} ghosts: pass table {:.1f} ms, "
+                        "analysis 1 thread {:.1f} ms, {} threads {:.1f} ms{}",
+                        num_nodes, inst_len, start_nodes.size(), ms(t1 - t0),
+                        ms(t2 - t1), num_threads, ms(t3 - t2),
+                        sequential == parallel ? "" : " MISMATCH") << endl;
+
+    // random networks rarely let all the ghosts meet, which is fine here
+    try
+    {
+        auto res = ghosts_meet(parallel);
+        cout << "ghosts meet after " << ((res == NO_HIT) ? "never"s : std::to_string(res)) << endl;
+    }
+    catch (str_cref e)
+    {
+        cout << "ghosts meet after ? (" << e << ")" << endl;
+    }
+}
+
+void part1()
+{
+    auto file_path = "res\\input.txt";
+    auto network = read_network(file_path);
+
+    auto ends = vec<u8>(network.nodes.size(), 0);
+    ends[network.id("ZZZ")] = 1;
+
+    Pass_Table table {network, std::move(ends)};
+
+    u64 res = table.first_hit(network.id("AAA"));
+    if (res == NO_HIT)
+        throw "ZZZ is never reached";
+
+    cout << "part 1 (" << file_path << ") " << res << endl;
+}
+
+void part2()
+{
+    auto file_path = "res\\input.txt";
+    auto network = read_network(file_path);
+
+    auto starts = network.ending_with('A');
+
+    Pass_Table table {network, network.ending_with('Z')};
+
+    vec<u16> start_nodes;
+
+    for (u16 start = 0;
+         start < network.nodes.size();
+         ++start)
+    {
+        if (starts[start])
+            start_nodes.push_back(start);
+    }
+
+    u64 res = ghosts_meet(table, start_nodes, std::thread::hardware_concurrency());
+    if (res == NO_HIT)
+        throw "The ghosts never all stand on Z nodes at once";
 
     cout << "part 2 (" << file_path << ") " << res << endl;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
     try
     {
+        // "day08 verify [rounds]" checks the pass table against plain walks
+        if (argc > 1 and argv[1] == "verify"sv)
+        {
+            verify((argc > 2) ? std::stoi(argv[2]) : 1'000);
+            return 0;
+        }
+
+        // "day08 bench [nodes] [instructions]" times the ghost analysis on a random network
+        if (argc > 1 and argv[1] == "bench"sv)
+        {
+            benchmark((argc > 2) ? std::stoi(argv[2]) : 10'000, (argc > 3) ? std::stoi(argv[3]) : 200);
+            return 0;
+        }
+
         part1();
         part2();
     }
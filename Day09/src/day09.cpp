@@ -2,10 +2,14 @@
 
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: https://pvs-studio.com
 
+#include <algorithm>
 #include <array>
 #include <assert.h>
+#include <charconv>
+#include <chrono>
 #include <cstdint>
 #include <exception>
+#include <stdexcept>
 #include <filesystem>
 #include <format>
 #include <fstream>
@@ -15,13 +19,26 @@
 #include <map>
 #include <numeric>
 #include <queue>
+#include <random>
 #include <ranges>
 #include <regex>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, so the kernels are always
+// built there and picked at run time; elsewhere only when the target has AVX2
+#if defined(_MSC_VER) and (defined(_M_X64) or defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define AVX2_KERNELS 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define AVX2_KERNELS 1
+#endif
+
 using u8 = uint8_t;
 using u16 = uint16_t;
 using u32 = uint32_t;
@@ -187,80 +204,709 @@ T solve(vec<T>& nums, bool part_one)
     }
 }
 
-void part1()
+bool add_overflows(i64 a, i64 b)
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
-    if (not ifs.is_open())
-        throw std::format("Cannot open file <{}>", file_path);
+    return (b > 0 and a > std::numeric_limits<i64>::max() - b) or
+           (b < 0 and a < std::numeric_limits<i64>::min() - b);
+}
+
+bool sub_overflows(i64 a, i64 b)
+{
+    return (b < 0 and a > std::numeric_limits<i64>::max() + b) or
+           (b > 0 and a < std::numeric_limits<i64>::min() + b);
+}
 
-    const auto pattern = std::regex(R"((-?\d+))");
+bool mul_overflows(i64 a, i64 b)
+{
+    constexpr auto max = std::numeric_limits<i64>::max();
+    constexpr auto min = std::numeric_limits<i64>::min();
 
-    i32 sum = 0;
+    return (a > 0) ? ((b > 0) ? (a > max / b) : (b < min / a))
+                   : ((b > 0) ? (a < min / b) : (a != 0 and b < max / a));
+}
 
-    str line;
-    for (;
-         std::getline(ifs, line);
+i64 checked_add(i64 a, i64 b)
+{
+    if (add_overflows(a, b))
+        throw std::overflow_error(std::format("[ERROR] {} + {} does not fit in 64 bits", a, b));
+
+    return a + b;
+}
+
+i64 checked_sub(i64 a, i64 b)
+{
+    if (sub_overflows(a, b))
+        throw std::overflow_error(std::format("[ERROR] {} - {} does not fit in 64 bits", a, b));
+
+    return a - b;
+}
+
+i64 checked_mul(i64 a, i64 b)
+{
+    if (mul_overflows(a, b))
+        throw std::overflow_error(std::format("[ERROR] {} * {} does not fit in 64 bits", a, b));
+
+    return a * b;
+}
+
+/**
+* The difference tables done in place with checked arithmetic, only throws
+* when a difference or the result itself does not fit in 64 bits
+*/
+i64 extrapolate_by_differences(vec<i64> nums, bool part_one)
+{
+    i64 res = 0;
+    bool add = true;
+
+    for (auto len = nums.size();
+         len > 0;
+         --len)
+    {
+        if (std::all_of(nums.begin(), nums.begin() + len, [](i64 num) { return num == 0; }))
+            break;
+
+        if (part_one)
+            res = checked_add(res, nums[len - 1]);
+        else
+            res = add ? checked_add(res, nums[0]) : checked_sub(res, nums[0]);
+
+        for (u64 i = 0;
+             i + 1 < len;
+             ++i)
+        {
+            nums[i] = checked_sub(nums[i + 1], nums[i]);
+        }
+
+        add = not add;
+    }
+
+    return res;
+}
+
+/**
+* One extrapolation of the len numbers nums[0], nums[stride], ... with the
+* coefficients of their length, through the difference tables when the
+* coefficients are missing or the dot product overflows
+*/
+i64 extrapolate(const vec<i64>& coeffs, const i64* nums, u64 stride, u64 len, bool part_one)
+{
+    if (coeffs.size() == len)
+    {
+        i64 res = 0;
+        bool overflow = false;
+
+        for (u64 i = 0;
+             i < len and not overflow;
+             ++i)
+        {
+            auto num = nums[i * stride];
+            overflow = mul_overflows(coeffs[i], num) or add_overflows(res, coeffs[i] * num);
+
+            if (not overflow)
+                res += coeffs[i] * num;
+        }
+
+        if (not overflow)
+            return res;
+    }
+
+    vec<i64> seq(len);
+    for (u64 i = 0;
+         i < len;
+         ++i)
+    {
+        seq[i] = nums[i * stride];
+    }
+
+    return extrapolate_by_differences(std::move(seq), part_one);
+}
+
+/**
+* Extrapolating with difference tables is linear in the inputs: for n
+* numbers the next one is sum (-1)^(n-1-i) * C(n, i) * x[i] and the one
+* before the first is sum (-1)^i * C(n, i+1) * x[i]. The coefficients are
+* computed once per sequence length, every sequence is then one dot
+* product.
+*
+* The terms of the dot product can overflow even when the result is small
+* (C(n, k) alone stops fitting at n = 67), so a dot product that overflows
+* falls back to the difference tables for that one sequence.
+*/
+struct Extrapolator
+{
+    // indexed by sequence length, empty when a coefficient does not fit
+    vec<vec<i64>> forward;
+    vec<vec<i64>> backward;
+
+    // row forward.size() - 1 of Pascal's triangle, the next one is built from it
+    vec<u64> binomial;
+    bool saturated {false};
+
+    // makes the coefficients of all lengths up to n available
+    void prepare(u64 n)
+    {
+        // binomials saturate here, anything that reaches it does not fit an i64
+        constexpr u64 LIMIT = u64 {1} << 63;
+
+        for (u64 len = forward.size();
+             len <= n;
+             ++len)
+        {
+            // once a row saturates every longer one does, they have no closed form
+            if (saturated)
+            {
+                forward.emplace_back();
+                backward.emplace_back();
+                continue;
+            }
+
+            // row len from row len - 1, in place from the back
+            for (u64 k = binomial.size();
+                 k-- > 1;
+                 )
+            {
+                binomial[k] = std::min(LIMIT, binomial[k] + binomial[k - 1]);
+            }
+            binomial.push_back(1);
+
+            saturated = std::ranges::any_of(binomial, [](u64 c) { return c >= LIMIT; });
+
+            vec<i64> fwd;
+            vec<i64> bwd;
+
+            if (not saturated)
+            {
+                for (u64 i = 0;
+                     i < len;
+                     ++i)
+                {
+                    auto f = static_cast<i64>(binomial[i]);
+                    auto b = static_cast<i64>(binomial[i + 1]);
+
+                    fwd.push_back(((len - 1 - i) % 2 == 0) ? f : -f);
+                    bwd.push_back((i % 2 == 0) ? b : -b);
+                }
+            }
+
+            forward.push_back(std::move(fwd));
+            backward.push_back(std::move(bwd));
+        }
+    }
+
+    const vec<i64>& coefficients(u64 n, bool part_one)
+    {
+        prepare(n);
+        return part_one ? forward[n] : backward[n];
+    }
+
+    i64 extrapolate(const vec<i64>& nums, bool part_one)
+    {
+        return ::extrapolate(coefficients(nums.size(), part_one), nums.data(), 1, nums.size(), part_one);
+    }
+};
+
+/**
+* Checks the extrapolator against the difference tables on random sequences
+*/
+void verify(u32 rounds)
+{
+    std::mt19937_64 rng {909};
+    Extrapolator extrapolator;
+
+    for (u32 i = 0;
+         i < rounds;
+         ++i)
+    {
+        auto pick = [&rng](i64 lo, i64 hi) { return std::uniform_int_distribution<i64> {lo, hi}(rng); };
+
+        // values of a random polynomial, or plain noise
+        vec<i64> poly(pick(1, 6));
+        for (auto& c : poly)
+        {
+            c = pick(-20, 20);
+        }
+
+        // some long enough for the dot product to overflow and fall back
+        vec<i64> nums(pick(1, (i % 8 == 1) ? 80 : 25));
+        for (u64 x = 0;
+             x < nums.size();
+             ++x)
+        {
+            if (i % 4 == 0)
+            {
+                nums[x] = pick(-1'000, 1'000);
+                continue;
+            }
+
+            for (auto c : poly)
+            {
+                nums[x] = nums[x] * static_cast<i64>(x) + c;
+            }
+        }
+
+        for (bool part_one : {true, false})
+        {
+            auto copy = nums;
+            auto expected = solve(copy, part_one);
+            auto actual = extrapolator.extrapolate(nums, part_one);
+
+            if (expected != actual)
+                throw std::format("sequence #{} ({} numbers): difference tables {}, coefficients {}",
+                                  i, nums.size(), expected, actual);
+        }
+    }
+
+    cout << "verify: " << rounds << " sequences OK" << endl;
+}
+
+/**
+* Sequences of one length stored column-major: number i of sequence s is
+* at nums[i * count + s], so the same position of consecutive sequences is
+* contiguous and both parts are two matrix-vector products.
+*/
+struct Batch
+{
+    u64 len {0};
+    u64 count {0};
+    vec<i64> nums;
+
+    // largest magnitude of any number, decides whether the SIMD path is exact
+    u64 max_abs {0};
+};
+
+struct Sums
+{
+    i64 next {0};
+    i64 prev {0};
+};
+
+/**
+* Parses every sequence of the input once and groups them by length
+*/
+map<u64, Batch> parse_batches(string_view text)
+{
+    // row-major per length first, the number of sequences isn't known up front
+    map<u64, vec<i64>> rows;
+    map<u64, u64> max_abs;
+
+    vec<i64> line;
+
+    for (u64 pos = 0;
+         pos < text.size();
          )
     {
-        auto token = line;
-        vec<i32> nums;
+        auto end = std::min(text.find('\n', pos), text.size());
+        line.clear();
 
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
+        for (u64 i = pos;
+             i < end;
              )
         {
-            nums.push_back(std::stoi(match[1].str()));
-            token = match.suffix();
+            auto ch = text[i];
+            if (ch == ' ' or ch == '\t' or ch == '\r')
+            {
+                ++i;
+                continue;
+            }
+
+            i64 num = 0;
+            auto [ptr, ec] = std::from_chars(text.data() + i, text.data() + end, num);
+
+            if (ec == std::errc::result_out_of_range)
+                throw std::format("Number out of range in line <{}>", text.substr(pos, end - pos));
+            if (ec != std::errc {})
+                throw std::format("Invalid number in line <{}>", text.substr(pos, end - pos));
+
+            line.push_back(num);
+            i = ptr - text.data();
+        }
+
+        if (not line.empty())
+        {
+            auto& row = rows[line.size()];
+            row.insert(row.end(), line.begin(), line.end());
+
+            auto& top = max_abs[line.size()];
+            for (auto num : line)
+            {
+                top = std::max(top, (num < 0) ? u64 {0} - static_cast<u64>(num) : static_cast<u64>(num));
+            }
         }
 
-        sum += solve(nums, true);
+        pos = end + 1;
     }
 
-    auto res = sum;
-    cout << "part 1 (" << file_path << ") " << res << endl;
+    map<u64, Batch> res;
+
+    for (const auto& [len, row] : rows)
+    {
+        auto& batch = res[len];
+        batch.len = len;
+        batch.count = row.size() / len;
+        batch.max_abs = max_abs[len];
+        batch.nums.resize(row.size());
+
+        for (u64 s = 0;
+             s < batch.count;
+             ++s)
+        {
+            for (u64 i = 0;
+                 i < len;
+                 ++i)
+            {
+                batch.nums[i * batch.count + s] = row[s * len + i];
+            }
+        }
+    }
+
+    return res;
 }
 
-void part2()
+/**
+* True when no dot product of the batch can overflow in a 64 bit lane and
+* all the factors fit in 32 bits, which is what AVX2 can multiply
+*/
+bool fits_lanes(const Batch& batch, const vec<i64>& forward, const vec<i64>& backward)
 {
-    auto file_path = "res\\input.txt";
-    auto ifs = std::ifstream(file_path);
-    if (not ifs.is_open())
-        throw std::format("Cannot open file <{}>", file_path);
+    constexpr i64 MAX_I32 = std::numeric_limits<i32>::max();
+
+    if (batch.max_abs > MAX_I32 or forward.size() != batch.len or backward.size() != batch.len)
+        return false;
+
+    for (const auto* coeffs : {&forward, &backward})
+    {
+        u64 sum_abs = 0;
+
+        for (auto c : *coeffs)
+        {
+            if (c > MAX_I32 or c < -MAX_I32)
+                return false;
+
+            sum_abs += static_cast<u64>(c < 0 ? -c : c);
+        }
+
+        if (batch.max_abs > 0 and sum_abs > static_cast<u64>(std::numeric_limits<i64>::max()) / batch.max_abs)
+            return false;
+    }
 
-    const auto pattern = std::regex(R"((-?\d+))");
+    return true;
+}
+
+/**
+* true when the CPU and the OS support AVX2
+*/
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER) and defined(AVX2_KERNELS)
+    std::array<int, 4> info {};
+
+    __cpuid(info.data(), 0);
+    if (info[0] < 7)
+        return false;
+
+    // AVX and OSXSAVE, then the OS must save the YMM registers
+    __cpuid(info.data(), 1);
+    if ((info[2] & (1 << 27)) == 0 or (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info.data(), 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(AVX2_KERNELS)
+    return true;
+#else
+    return false;
+#endif
+}
 
-    i32 sum = 0;
+static const bool HAS_AVX2 = cpu_has_avx2();
 
-    str line;
+#if defined(AVX2_KERNELS)
+/**
+* Adds the extrapolations of sequences [begin, end) four at a time to res,
+* the batch must fit the lanes. Returns the first sequence left over.
+*/
+u64 extrapolate_lanes_avx2(const Batch& batch, const vec<i64>& forward, const vec<i64>& backward, u64 begin, u64 end, Sums& res)
+{
+    const auto* nums = batch.nums.data();
+    auto count = batch.count;
+    u64 s = begin;
+
+    // products of the low 32 bits of each lane are exact here
     for (;
-         std::getline(ifs, line);
-         )
+         s + 4 <= end;
+         s += 4)
     {
-        auto token = line;
-        vec<i32> nums;
+        auto next = _mm256_setzero_si256();
+        auto prev = _mm256_setzero_si256();
 
-        for (std::smatch match;
-             std::regex_search(token, match, pattern);
-             )
+        for (u64 i = 0;
+             i < batch.len;
+             ++i)
+        {
+            auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(nums + i * count + s));
+
+            next = _mm256_add_epi64(next, _mm256_mul_epi32(x, _mm256_set1_epi64x(forward[i])));
+            prev = _mm256_add_epi64(prev, _mm256_mul_epi32(x, _mm256_set1_epi64x(backward[i])));
+        }
+
+        alignas(32) std::array<i64, 4> next_lanes;
+        alignas(32) std::array<i64, 4> prev_lanes;
+        _mm256_store_si256(reinterpret_cast<__m256i*>(next_lanes.data()), next);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(prev_lanes.data()), prev);
+
+        for (u64 lane = 0;
+             lane < 4;
+             ++lane)
+        {
+            res.next = checked_add(res.next, next_lanes[lane]);
+            res.prev = checked_add(res.prev, prev_lanes[lane]);
+        }
+    }
+
+    return s;
+}
+#endif
+
+/**
+* Both extrapolations of sequences [begin, end) of the batch
+*/
+Sums extrapolate_batch(const Batch& batch, const vec<i64>& forward, const vec<i64>& backward, u64 begin, u64 end)
+{
+    Sums res;
+    u64 s = begin;
+
+    const auto* nums = batch.nums.data();
+    auto count = batch.count;
+
+    if (fits_lanes(batch, forward, backward))
+    {
+#if defined(AVX2_KERNELS)
+        if (HAS_AVX2)
+            s = extrapolate_lanes_avx2(batch, forward, backward, s, end, res);
+#endif
+        for (;
+             s < end;
+             ++s)
+        {
+            i64 next = 0;
+            i64 prev = 0;
+
+            for (u64 i = 0;
+                 i < batch.len;
+                 ++i)
+            {
+                next += forward[i] * nums[i * count + s];
+                prev += backward[i] * nums[i * count + s];
+            }
+
+            res.next = checked_add(res.next, next);
+            res.prev = checked_add(res.prev, prev);
+        }
+    }
+    else
+    {
+        for (;
+             s < end;
+             ++s)
+        {
+            res.next = checked_add(res.next, extrapolate(forward, nums + s, count, batch.len, true));
+            res.prev = checked_add(res.prev, extrapolate(backward, nums + s, count, batch.len, false));
+        }
+    }
+
+    return res;
+}
+
+/**
+* Sums of both extrapolations over all the batches, large batches are split
+* into one range of sequences per thread
+*/
+Sums extrapolate_all(const map<u64, Batch>& batches, Extrapolator& extrapolator, u32 num_threads)
+{
+    // below about a million numbers starting the threads costs more than it saves
+    constexpr u64 PARALLEL_SIZE = 1 << 20;
+
+    Sums res;
+
+    for (const auto& [len, batch] : batches)
+    {
+        // the coefficients are computed here, the threads only read them
+        const auto& forward = extrapolator.coefficients(len, true);
+        const auto& backward = extrapolator.coefficients(len, false);
+
+        u64 num_parts = (batch.nums.size() >= PARALLEL_SIZE) ? std::max(1u, num_threads) : 1;
+
+        if (num_parts == 1)
         {
-            nums.push_back(std::stoi(match[1].str()));
-            token = match.suffix();
+            auto part = extrapolate_batch(batch, forward, backward, 0, batch.count);
+
+            res.next = checked_add(res.next, part.next);
+            res.prev = checked_add(res.prev, part.prev);
+            continue;
+        }
+
+        vec<Sums> parts(num_parts);
+
+        // an overflow in a worker is rethrown here instead of ending the process
+        vec<std::exception_ptr> errors(num_parts);
+
+        {
+            vec<std::jthread> threads;
+
+            for (u64 t = 0;
+                 t < num_parts;
+                 ++t)
+            {
+                // ranges start on a multiple of 4 so the lanes stay full
+                auto begin = std::min(batch.count, (batch.count * t / num_parts) & ~u64 {3});
+                auto end = (t + 1 == num_parts) ? batch.count : std::min(batch.count, (batch.count * (t + 1) / num_parts) & ~u64 {3});
+
+                threads.emplace_back([&, t, begin, end]()
+                {
+                    try
+                    {
+                        parts[t] = extrapolate_batch(batch, forward, backward, begin, end);
+                    }
+                    catch (...)
+                    {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+        }
+
+        for (const auto& error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
         }
 
-        sum += solve(nums, false);
+        for (const auto& part : parts)
+        {
+            res.next = checked_add(res.next, part.next);
+            res.prev = checked_add(res.prev, part.prev);
+        }
     }
 
-    auto res = sum;
+    return res;
+}
+
+/**
+* Times the batched extrapolation against the per-sequence one on random
+* polynomial sequences
+*/
+void benchmark(u64 count, u64 len)
+{
+    using clock = std::chrono::steady_clock;
+    auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    std::mt19937_64 rng {99};
+    auto pick = [&rng](i64 lo, i64 hi) { return std::uniform_int_distribution<i64> {lo, hi}(rng); };
+
+    Batch batch;
+    batch.len = len;
+    batch.count = count;
+    batch.nums.resize(count * len);
+
+    for (u64 s = 0;
+         s < count;
+         ++s)
+    {
+        // degree 3 polynomials stay well inside 32 bits for real input sizes
+        auto a = pick(-9, 9), b = pick(-99, 99), c = pick(-999, 999), d = pick(-9'999, 9'999);
+
+        for (u64 x = 0;
+             x < len;
+             ++x)
+        {
+            auto v = static_cast<i64>(x);
+            auto num = ((a * v + b) * v + c) * v + d;
+
+            batch.nums[x * count + s] = num;
+            batch.max_abs = std::max<u64>(batch.max_abs, (num < 0) ? -num : num);
+        }
+    }
+
+    map<u64, Batch> batches;
+    batches[len] = std::move(batch);
+
+    Extrapolator extrapolator;
+    auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto t0 = clock::now();
+    Sums expected;
+    vec<i64> nums(len);
+    const auto& stored = batches[len];
+
+    for (u64 s = 0;
+         s < count;
+         ++s)
+    {
+        for (u64 i = 0;
+             i < len;
+             ++i)
+        {
+            nums[i] = stored.nums[i * count + s];
+        }
+
+        expected.next = checked_add(expected.next, extrapolator.extrapolate(nums, true));
+        expected.prev = checked_add(expected.prev, extrapolator.extrapolate(nums, false));
+    }
+
+    auto t1 = clock::now();
+    auto actual = extrapolate_all(batches, extrapolator, num_threads);
+    auto t2 = clock::now();
+
+    auto rate = [count, len](double millis) { return static_cast<double>(count * len) / millis / 1'000.0; };
+
+    cout << std::format("{} sequences of {}: per sequence {:.1f} ms ({:.1f} M numbers/s), "
+                        "batched ({} threads) {:.1f} ms ({:.1f} M numbers/s){}",
+                        count, len, ms(t1 - t0), rate(ms(t1 - t0)),
+                        num_threads, ms(t2 - t1), rate(ms(t2 - t1)),
+                        (expected.next == actual.next and expected.prev == actual.prev) ? "" : " MISMATCH") << endl;
+}
+
+void part1(const char* file_path, const Sums& sums)
+{
+    auto res = sums.next;
+    cout << "part 1 (" << file_path << ") " << res << endl;
+}
+
+void part2(const char* file_path, const Sums& sums)
+{
+    auto res = sums.prev;
     cout << "part 2 (" << file_path << ") " << res << endl;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
     try
     {
-        part1();
-        part2();
+        // "day09 verify [rounds]" checks the coefficients against the difference tables
+        if (argc > 1 and argv[1] == "verify"sv)
+        {
+            verify((argc > 2) ? std::stoi(argv[2]) : 10'000);
+            return 0;
+        }
+
+        // "day09 bench [sequences] [length]" times the batched extrapolation
+        if (argc > 1 and argv[1] == "bench"sv)
+        {
+            benchmark((argc > 2) ? std::stoull(argv[2]) : 4'000'000, (argc > 3) ? std::stoull(argv[3]) : 21);
+            return 0;
+        }
+
+        // both parts come out of one parse
+        auto file_path = "res\\input.txt";
+        auto batches = parse_batches(read_file(file_path));
+
+        Extrapolator extrapolator;
+        auto sums = extrapolate_all(batches, extrapolator, std::thread::hardware_concurrency());
+
+        part1(file_path, sums);
+        part2(file_path, sums);
     }
     catch (const char* e)
     {